@@ -0,0 +1,325 @@
+/*
+ * Runs an experiment configuration for a range of random seeds in parallel argos3 processes.
+ *
+ * For each seed, the configuration template is rewritten so that the random seed is replaced,
+ * the visualization is disabled and the files of the loop function log are written into a
+ * separate directory (seed_<seed>/ in the output directory). The runs are executed by a fixed
+ * number of workers, each of which is pinned to a core. The standard output and error of each
+ * run are written into its directory and the step at which the loop functions terminated the
+ * experiment is collected into summary.csv.
+ *
+ * Since the controllers load their Lua modules relative to the working directory, the runner
+ * should be started from the directory of the experiment.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/****************************************/
+/****************************************/
+
+struct SRun {
+   unsigned int Seed;
+   std::string Directory;
+   pid_t Process = -1;
+   unsigned int Worker = 0;
+   int Status = 0;
+   /* the step at which the experiment was terminated, negative if it was not terminated */
+   long long CompletionStep = -1;
+   std::chrono::steady_clock::time_point Start;
+   double Duration = 0.0;
+};
+
+/****************************************/
+/****************************************/
+
+void PrintUsage(const char* pch_program) {
+   std::cerr << "Usage: " << pch_program
+             << " -c TEMPLATE -s FIRST_SEED:LAST_SEED [-j WORKERS] [-o OUTPUT_DIRECTORY] [-a ARGOS3]"
+             << std::endl;
+}
+
+/****************************************/
+/****************************************/
+
+bool MakeDirectory(const std::string& str_path) {
+   /* create the parents first */
+   std::string::size_type unSeparator = str_path.find('/', 1);
+   while(unSeparator != std::string::npos) {
+      std::string strParent = str_path.substr(0, unSeparator);
+      if(::mkdir(strParent.c_str(), 0755) != 0 && errno != EEXIST) {
+         return false;
+      }
+      unSeparator = str_path.find('/', unSeparator + 1);
+   }
+   return (::mkdir(str_path.c_str(), 0755) == 0 || errno == EEXIST);
+}
+
+/****************************************/
+/****************************************/
+
+std::string RewriteConfiguration(const std::string& str_template,
+                                 unsigned int un_seed,
+                                 const std::string& str_prefix) {
+   std::string strConfiguration = str_template;
+   /* replace the random seed */
+   static const std::regex cRandomSeed("random_seed\\s*=\\s*\"[^\"]*\"");
+   strConfiguration = std::regex_replace(strConfiguration,
+                                         cRandomSeed,
+                                         "random_seed=\"" + std::to_string(un_seed) + "\"");
+   /* remove comments so that commented out elements are not matched below */
+   static const std::regex cComment("<!--[\\s\\S]*?-->");
+   strConfiguration = std::regex_replace(strConfiguration, cComment, "");
+   /* run without the graphical user interface */
+   static const std::regex cVisualization("<visualization[\\s\\S]*?</visualization>|<visualization[^>]*/>");
+   strConfiguration = std::regex_replace(strConfiguration, cVisualization, "<visualization />");
+   /* write the log into the directory of the run */
+   static const std::regex cLogPrefix("(<log\\b[^>]*?)\\s+prefix\\s*=\\s*\"[^\"]*\"");
+   strConfiguration = std::regex_replace(strConfiguration, cLogPrefix, "$1");
+   static const std::regex cLog("<log\\b");
+   if(std::regex_search(strConfiguration, cLog)) {
+      strConfiguration = std::regex_replace(strConfiguration,
+                                            cLog,
+                                            "<log prefix=\"" + str_prefix + "\"");
+   }
+   else {
+      static const std::regex cLoopFunctions("(<loop_functions\\b[^>]*[^/]>)");
+      strConfiguration = std::regex_replace(strConfiguration,
+                                            cLoopFunctions,
+                                            "$1\n    <log prefix=\"" + str_prefix + "\"/>");
+   }
+   return strConfiguration;
+}
+
+/****************************************/
+/****************************************/
+
+pid_t StartRun(const SRun& s_run,
+               const std::string& str_argos,
+               unsigned int un_core) {
+   pid_t nProcess = ::fork();
+   if(nProcess != 0) {
+      return nProcess;
+   }
+   /* in the child process */
+#ifdef __linux__
+   cpu_set_t sCores;
+   CPU_ZERO(&sCores);
+   CPU_SET(un_core, &sCores);
+   if(::sched_setaffinity(0, sizeof(sCores), &sCores) != 0) {
+      std::cerr << "[WARNING] Could not pin the run with seed " << s_run.Seed
+                << " to core " << un_core << std::endl;
+   }
+#endif
+   std::string strOutput = s_run.Directory + "/stdout.txt";
+   std::string strError = s_run.Directory + "/stderr.txt";
+   int nOutput = ::open(strOutput.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   int nError = ::open(strError.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if(nOutput < 0 || nError < 0) {
+      std::cerr << "[ERROR] Could not create the output files in " << s_run.Directory << std::endl;
+      ::_exit(EXIT_FAILURE);
+   }
+   ::dup2(nOutput, STDOUT_FILENO);
+   ::dup2(nError, STDERR_FILENO);
+   ::close(nOutput);
+   ::close(nError);
+   std::string strConfiguration = s_run.Directory + "/experiment.argos";
+   ::execlp(str_argos.c_str(), str_argos.c_str(), "-c", strConfiguration.c_str(), nullptr);
+   std::cerr << "[ERROR] Could not execute " << str_argos << ": " << std::strerror(errno) << std::endl;
+   ::_exit(EXIT_FAILURE);
+}
+
+/****************************************/
+/****************************************/
+
+long long ReadCompletionStep(const std::string& str_directory) {
+   /* written by STerminateAction */
+   static const std::string strMarker("Terminating the experiment at step ");
+   std::ifstream cOutput(str_directory + "/stdout.txt");
+   std::string strLine;
+   long long nCompletionStep = -1;
+   while(std::getline(cOutput, strLine)) {
+      std::string::size_type unPosition = strLine.find(strMarker);
+      if(unPosition != std::string::npos) {
+         nCompletionStep = std::atoll(strLine.c_str() + unPosition + strMarker.size());
+      }
+   }
+   return nCompletionStep;
+}
+
+/****************************************/
+/****************************************/
+
+int main(int n_argc, char** ppch_argv) {
+   std::string strTemplate;
+   std::string strOutputDirectory("batch");
+   std::string strArgos("argos3");
+   unsigned int unFirstSeed = 0;
+   unsigned int unLastSeed = 0;
+   bool bSeeds = false;
+   unsigned int unCores = std::max(1l, ::sysconf(_SC_NPROCESSORS_ONLN));
+   unsigned int unWorkers = unCores;
+   int nOption;
+   while((nOption = ::getopt(n_argc, ppch_argv, "c:s:j:o:a:h")) != -1) {
+      switch(nOption) {
+         case 'c':
+            strTemplate = optarg;
+            break;
+         case 's':
+            if(std::sscanf(optarg, "%u:%u", &unFirstSeed, &unLastSeed) == 2) {
+               bSeeds = true;
+            }
+            else if(std::sscanf(optarg, "%u", &unFirstSeed) == 1) {
+               unLastSeed = unFirstSeed;
+               bSeeds = true;
+            }
+            break;
+         case 'j':
+            unWorkers = std::strtoul(optarg, nullptr, 10);
+            break;
+         case 'o':
+            strOutputDirectory = optarg;
+            break;
+         case 'a':
+            strArgos = optarg;
+            break;
+         default:
+            PrintUsage(ppch_argv[0]);
+            return EXIT_FAILURE;
+      }
+   }
+   if(strTemplate.empty() || !bSeeds || unFirstSeed > unLastSeed || unWorkers == 0) {
+      PrintUsage(ppch_argv[0]);
+      return EXIT_FAILURE;
+   }
+   /* read the template */
+   std::ifstream cTemplateFile(strTemplate);
+   if(!cTemplateFile) {
+      std::cerr << "[ERROR] Could not open " << strTemplate << std::endl;
+      return EXIT_FAILURE;
+   }
+   std::ostringstream cTemplate;
+   cTemplate << cTemplateFile.rdbuf();
+   /* prepare the runs */
+   std::vector<SRun> vecRuns;
+   for(unsigned long long unSeed = unFirstSeed; unSeed <= unLastSeed; unSeed++) {
+      SRun sRun;
+      sRun.Seed = unSeed;
+      sRun.Directory = strOutputDirectory + "/seed_" + std::to_string(unSeed);
+      if(!MakeDirectory(sRun.Directory)) {
+         std::cerr << "[ERROR] Could not create " << sRun.Directory << std::endl;
+         return EXIT_FAILURE;
+      }
+      std::ofstream cConfiguration(sRun.Directory + "/experiment.argos");
+      cConfiguration << RewriteConfiguration(cTemplate.str(), sRun.Seed, sRun.Directory + "/");
+      if(!cConfiguration) {
+         std::cerr << "[ERROR] Could not write the configuration into " << sRun.Directory << std::endl;
+         return EXIT_FAILURE;
+      }
+      vecRuns.push_back(sRun);
+   }
+   /* execute the runs, each worker runs one process at a time on its own core */
+   std::vector<SRun*> vecWorkers(unWorkers, nullptr);
+   size_t unNextRun = 0;
+   size_t unRunning = 0;
+   while(unNextRun < vecRuns.size() || unRunning > 0) {
+      for(unsigned int unWorker = 0; unWorker < unWorkers && unNextRun < vecRuns.size(); unWorker++) {
+         if(vecWorkers[unWorker] == nullptr) {
+            SRun& sRun = vecRuns[unNextRun++];
+            sRun.Worker = unWorker;
+            sRun.Start = std::chrono::steady_clock::now();
+            sRun.Process = StartRun(sRun, strArgos, unWorker % unCores);
+            if(sRun.Process < 0) {
+               std::cerr << "[ERROR] Could not start the run with seed " << sRun.Seed << std::endl;
+               return EXIT_FAILURE;
+            }
+            vecWorkers[unWorker] = &sRun;
+            unRunning++;
+         }
+      }
+      int nStatus;
+      pid_t nProcess = ::wait(&nStatus);
+      if(nProcess < 0) {
+         if(errno == EINTR) {
+            continue;
+         }
+         break;
+      }
+      for(SRun*& ps_run : vecWorkers) {
+         if(ps_run != nullptr && ps_run->Process == nProcess) {
+            ps_run->Status = nStatus;
+            ps_run->Duration = std::chrono::duration<double>(
+               std::chrono::steady_clock::now() - ps_run->Start).count();
+            ps_run->CompletionStep = ReadCompletionStep(ps_run->Directory);
+            std::cout << "seed " << ps_run->Seed << ": "
+                      << ((WIFEXITED(nStatus) && WEXITSTATUS(nStatus) == 0) ? "finished" : "failed");
+            if(ps_run->CompletionStep >= 0) {
+               std::cout << " at step " << ps_run->CompletionStep;
+            }
+            std::cout << " (" << std::fixed << std::setprecision(1) << ps_run->Duration << " s)"
+                      << std::endl;
+            ps_run = nullptr;
+            unRunning--;
+            break;
+         }
+      }
+   }
+   /* write the summary */
+   std::ofstream cSummary(strOutputDirectory + "/summary.csv");
+   cSummary << "seed,exit_status,completion_step,duration" << std::endl;
+   unsigned int unFailed = 0;
+   unsigned int unCompleted = 0;
+   long long nMinimum = 0, nMaximum = 0;
+   double fSum = 0.0;
+   for(const SRun& s_run : vecRuns) {
+      bool bSuccess = WIFEXITED(s_run.Status) && WEXITSTATUS(s_run.Status) == 0;
+      cSummary << s_run.Seed << ','
+               << (WIFEXITED(s_run.Status) ? WEXITSTATUS(s_run.Status) : -1) << ','
+               << s_run.CompletionStep << ','
+               << s_run.Duration << std::endl;
+      if(!bSuccess) {
+         unFailed++;
+      }
+      else if(s_run.CompletionStep >= 0) {
+         if(unCompleted == 0) {
+            nMinimum = nMaximum = s_run.CompletionStep;
+         }
+         nMinimum = std::min(nMinimum, s_run.CompletionStep);
+         nMaximum = std::max(nMaximum, s_run.CompletionStep);
+         fSum += s_run.CompletionStep;
+         unCompleted++;
+      }
+   }
+   std::cout << vecRuns.size() << " runs, "
+             << unFailed << " failed, "
+             << unCompleted << " terminated by the loop functions";
+   if(unCompleted > 0) {
+      std::cout << ", completion step mean " << std::setprecision(1) << (fSum / unCompleted)
+                << " min " << nMinimum
+                << " max " << nMaximum;
+   }
+   std::cout << std::endl;
+   return (unFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/****************************************/
+/****************************************/
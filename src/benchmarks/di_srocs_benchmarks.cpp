@@ -0,0 +1,475 @@
+/*
+ * Micro-benchmarks for the loop functions.
+ *
+ * For each combination of the number of blocks (-n), the number of conditions of each type (-m)
+ * and the number of pending actions (-k), a synthetic experiment configuration is generated and
+ * loaded into the simulator. The benchmark then advances the simulation clock and calls PreStep
+ * and PostStep of the loop functions directly, so that neither the physics engines nor the
+ * controllers are stepped, and reports the time and the number of heap allocations per tick.
+ *
+ * The synthetic configuration contains:
+ *  - n blocks on a grid with a spacing of 0.1 m,
+ *  - m conditions of each type (entity, timer, all, any and not) at random positions,
+ *  - a condition that is true on every step and schedules a remove_entity action (that does not
+ *    match any entity) with a delay of k steps, so that k actions are pending once the benchmark
+ *    has warmed up,
+ *  - a condition that starts the timer referenced by the timer conditions once.
+ *
+ * Each case is run in a separate process, since the simulator can only load one experiment.
+ *
+ * With -z, the benchmark fails if the loop functions allocate memory on any of the measured ticks,
+ * e.g., -z -t 10000 checks that the steady state of the loop functions is allocation free. The
+ * check_allocations target of the build runs this check.
+ */
+
+#include <argos3/core/simulator/simulator.h>
+#include <argos3/core/simulator/loop_functions.h>
+#include <argos3/core/simulator/space/space.h>
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/plugins/dynamic_loading.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef DI_SROCS_LOOP_FUNCTIONS_LIBRARY
+#define DI_SROCS_LOOP_FUNCTIONS_LIBRARY "libdi_srocs_loop_functions"
+#endif
+
+/****************************************/
+/****************************************/
+
+/* count the heap allocations of the whole process, including those of the loop functions */
+static std::atomic<unsigned long long> g_unAllocations(0);
+
+void* operator new(std::size_t un_size) {
+   g_unAllocations.fetch_add(1, std::memory_order_relaxed);
+   if(void* pvMemory = std::malloc(un_size == 0 ? 1 : un_size)) {
+      return pvMemory;
+   }
+   throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t un_size) {
+   return operator new(un_size);
+}
+
+void* operator new(std::size_t un_size, const std::nothrow_t&) noexcept {
+   g_unAllocations.fetch_add(1, std::memory_order_relaxed);
+   return std::malloc(un_size == 0 ? 1 : un_size);
+}
+
+void* operator new[](std::size_t un_size, const std::nothrow_t& t_nothrow) noexcept {
+   return operator new(un_size, t_nothrow);
+}
+
+void operator delete(void* pv_memory) noexcept {
+   std::free(pv_memory);
+}
+
+void operator delete[](void* pv_memory) noexcept {
+   std::free(pv_memory);
+}
+
+void operator delete(void* pv_memory, std::size_t) noexcept {
+   std::free(pv_memory);
+}
+
+void operator delete[](void* pv_memory, std::size_t) noexcept {
+   std::free(pv_memory);
+}
+
+/****************************************/
+/****************************************/
+
+struct SCase {
+   unsigned int Blocks;
+   unsigned int Conditions;
+   unsigned int PendingActions;
+};
+
+struct SResult {
+   double NanosecondsPerTick = 0.0;
+   double AllocationsPerTick = 0.0;
+};
+
+/****************************************/
+/****************************************/
+
+void PrintUsage(const char* pch_program) {
+   std::cerr << "Usage: " << pch_program
+             << " [-n BLOCKS,...] [-m CONDITIONS,...] [-k PENDING_ACTIONS,...]"
+             << " [-e polling|event|verify] [-t TICKS] [-w WARMUP_TICKS] [-s SEED]"
+             << " [-l LOOP_FUNCTIONS_LIBRARY] [-o CSV_FILE] [-z]"
+             << std::endl;
+}
+
+/****************************************/
+/****************************************/
+
+bool ParseList(const char* pch_list, std::vector<unsigned int>& vec_values) {
+   vec_values.clear();
+   std::istringstream cList(pch_list);
+   std::string strValue;
+   while(std::getline(cList, strValue, ',')) {
+      char* pchEnd;
+      unsigned long unValue = std::strtoul(strValue.c_str(), &pchEnd, 10);
+      if(strValue.empty() || *pchEnd != '\0') {
+         return false;
+      }
+      vec_values.push_back(unValue);
+   }
+   return !vec_values.empty();
+}
+
+/****************************************/
+/****************************************/
+
+std::string GenerateConfiguration(const SCase& s_case,
+                                  const std::string& str_library,
+                                  const std::string& str_evaluation,
+                                  const std::string& str_directory,
+                                  unsigned int un_seed) {
+   /* place the blocks on a square grid */
+   unsigned int unSide = std::ceil(std::sqrt(static_cast<double>(s_case.Blocks)));
+   double fArenaSize = unSide * 0.1 + 0.2;
+   std::mt19937 cRandom(un_seed);
+   std::uniform_real_distribution<double> cCoordinate(0.1, fArenaSize - 0.1);
+   std::uniform_int_distribution<unsigned int> cTimerValue(0, 1000);
+   auto fnEntityCondition = [&] (std::ostream& c_stream, const char* pch_indent) {
+      c_stream << pch_indent << "<condition type=\"entity\" target=\"block:\" position=\""
+               << cCoordinate(cRandom) << ',' << cCoordinate(cRandom) << ",0\" threshold=\"0.1\"/>\n";
+   };
+   auto fnTimerCondition = [&] (std::ostream& c_stream, const char* pch_indent) {
+      c_stream << pch_indent << "<condition type=\"timer\" id=\"benchmark\" value=\""
+               << cTimerValue(cRandom) << "\"/>\n";
+   };
+   std::ostringstream cConfiguration;
+   cConfiguration << std::fixed << std::setprecision(4);
+   cConfiguration <<
+      "<?xml version=\"1.0\" ?>\n"
+      "<argos-configuration>\n"
+      "  <framework>\n"
+      "    <system threads=\"0\" />\n"
+      "    <experiment length=\"0\" ticks_per_second=\"5\" random_seed=\"" << un_seed << "\" />\n"
+      "  </framework>\n"
+      "  <controllers>\n"
+      "    <lua_controller id=\"block\">\n"
+      "      <actuators>\n"
+      "        <directional_leds implementation=\"default\" />\n"
+      "        <radios implementation=\"default\"/>\n"
+      "        <debug implementation=\"default\">\n"
+      "          <interface id=\"draw\" />\n"
+      "          <interface id=\"loop_functions\" />\n"
+      "        </debug>\n"
+      "      </actuators>\n"
+      "      <sensors>\n"
+      "        <radios implementation=\"default\" show_rays=\"false\"/>\n"
+      "      </sensors>\n"
+      "      <params />\n"
+      "    </lua_controller>\n"
+      "  </controllers>\n"
+      "  <loop_functions library=\"" << str_library << "\"\n"
+      "                  label=\"di_srocs_loop_functions\"\n"
+      "                  evaluation=\"" << str_evaluation << "\">\n"
+      "    <log interleaved=\"true\" file=\"loop_functions.csv\" prefix=\"" << str_directory << "/\"/>\n";
+   /* k pending actions: a condition that is always true schedules an action every step */
+   cConfiguration <<
+      "    <condition type=\"not\" once=\"true\">\n"
+      "      <condition type=\"entity\" target=\"block:\" position=\"-10,-10,0\" threshold=\"0.1\"/>\n"
+      "      <action type=\"add_timer\" id=\"benchmark\" delay=\"0\"/>\n"
+      "    </condition>\n"
+      "    <condition type=\"not\">\n"
+      "      <condition type=\"entity\" target=\"block:\" position=\"-10,-10,0\" threshold=\"0.1\"/>\n"
+      "      <action type=\"remove_entity\" target=\"block:\" position=\"-10,-10,0\" threshold=\"0.1\""
+      " delay=\"" << s_case.PendingActions << "\"/>\n"
+      "    </condition>\n";
+   for(unsigned int unCondition = 0; unCondition < s_case.Conditions; unCondition++) {
+      fnEntityCondition(cConfiguration, "    ");
+      fnTimerCondition(cConfiguration, "    ");
+      cConfiguration << "    <condition type=\"all\">\n";
+      fnEntityCondition(cConfiguration, "      ");
+      fnEntityCondition(cConfiguration, "      ");
+      cConfiguration << "    </condition>\n"
+                     << "    <condition type=\"any\">\n";
+      fnEntityCondition(cConfiguration, "      ");
+      fnTimerCondition(cConfiguration, "      ");
+      cConfiguration << "    </condition>\n"
+                     << "    <condition type=\"not\">\n";
+      fnEntityCondition(cConfiguration, "      ");
+      cConfiguration << "    </condition>\n";
+   }
+   cConfiguration <<
+      "  </loop_functions>\n"
+      "  <arena size=\"" << fArenaSize << ',' << fArenaSize << ",1\" center=\""
+                         << (fArenaSize * 0.5) << ',' << (fArenaSize * 0.5) << ",0.5\">\n";
+   for(unsigned int unBlock = 0; unBlock < s_case.Blocks; unBlock++) {
+      cConfiguration <<
+         "    <block id=\"block" << unBlock << "\" debug=\"false\" movable=\"true\">\n"
+         "      <body position=\"" << (0.1 + 0.1 * (unBlock % unSide)) << ','
+                                   << (0.1 + 0.1 * (unBlock / unSide)) << ",0\" orientation=\"0,0,0\"/>\n"
+         "      <controller config=\"block\"/>\n"
+         "    </block>\n";
+   }
+   cConfiguration <<
+      "  </arena>\n"
+      "  <physics_engines>\n"
+      "    <dynamics3d id=\"dyn3d\" iterations=\"25\" default_friction=\"1\">\n"
+      "      <gravity g=\"9.8\" />\n"
+      "      <floor height=\"0.01\" friction=\"1\"/>\n"
+      "      <virtual_magnetism />\n"
+      "    </dynamics3d>\n"
+      "  </physics_engines>\n"
+      "  <media>\n"
+      "    <directional_led id=\"directional_leds\" index=\"grid\" grid_size=\"20,20,20\"/>\n"
+      "    <tag id=\"tags\" index=\"grid\" grid_size=\"20,20,20\" />\n"
+      "    <radio id=\"nfc\" index=\"grid\" grid_size=\"20,20,20\" />\n"
+      "    <radio id=\"wifi\" index=\"grid\" grid_size=\"20,20,20\" />\n"
+      "  </media>\n"
+      "  <visualization />\n"
+      "</argos-configuration>\n";
+   return cConfiguration.str();
+}
+
+/****************************************/
+/****************************************/
+
+/* runs in the child process, returns false if the experiment could not be loaded */
+bool RunCase(const std::string& str_configuration,
+             unsigned int un_warmup_ticks,
+             unsigned int un_ticks,
+             SResult& s_result) {
+   using namespace argos;
+   try {
+      CDynamicLoading::LoadAllLibraries();
+      CSimulator& cSimulator = CSimulator::GetInstance();
+      cSimulator.SetExperimentFileName(str_configuration);
+      cSimulator.LoadExperiment();
+      CSpace& cSpace = cSimulator.GetSpace();
+      CLoopFunctions& cLoopFunctions = cSimulator.GetLoopFunctions();
+      auto fnTick = [&] {
+         cSpace.IncreaseSimulationClock();
+         cLoopFunctions.PreStep();
+         cLoopFunctions.PostStep();
+      };
+      for(unsigned int unTick = 0; unTick < un_warmup_ticks; unTick++) {
+         fnTick();
+      }
+      unsigned long long unAllocations = g_unAllocations.load();
+      std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+      for(unsigned int unTick = 0; unTick < un_ticks; unTick++) {
+         fnTick();
+      }
+      std::chrono::steady_clock::time_point tEnd = std::chrono::steady_clock::now();
+      unAllocations = g_unAllocations.load() - unAllocations;
+      s_result.NanosecondsPerTick =
+         std::chrono::duration<double, std::nano>(tEnd - tStart).count() / un_ticks;
+      s_result.AllocationsPerTick = static_cast<double>(unAllocations) / un_ticks;
+      cSimulator.Destroy();
+   }
+   catch(CARGoSException& ex_error) {
+      std::cerr << "[ERROR] " << ex_error.what() << std::endl;
+      return false;
+   }
+   return true;
+}
+
+/****************************************/
+/****************************************/
+
+bool ForkCase(const std::string& str_configuration,
+              unsigned int un_warmup_ticks,
+              unsigned int un_ticks,
+              SResult& s_result) {
+   int pnPipe[2];
+   if(::pipe(pnPipe) != 0) {
+      return false;
+   }
+   pid_t nProcess = ::fork();
+   if(nProcess < 0) {
+      ::close(pnPipe[0]);
+      ::close(pnPipe[1]);
+      return false;
+   }
+   if(nProcess == 0) {
+      /* in the child process, discard the output of the simulator */
+      ::close(pnPipe[0]);
+      int nNull = ::open("/dev/null", O_WRONLY);
+      if(nNull >= 0) {
+         ::dup2(nNull, STDOUT_FILENO);
+         ::close(nNull);
+      }
+      SResult sResult;
+      bool bSuccess = RunCase(str_configuration, un_warmup_ticks, un_ticks, sResult);
+      if(bSuccess) {
+         bSuccess = (::write(pnPipe[1], &sResult, sizeof(sResult)) == sizeof(sResult));
+      }
+      ::close(pnPipe[1]);
+      ::_exit(bSuccess ? EXIT_SUCCESS : EXIT_FAILURE);
+   }
+   ::close(pnPipe[1]);
+   bool bReceived = (::read(pnPipe[0], &s_result, sizeof(s_result)) == sizeof(s_result));
+   ::close(pnPipe[0]);
+   int nStatus;
+   while(::waitpid(nProcess, &nStatus, 0) < 0 && errno == EINTR);
+   return bReceived && WIFEXITED(nStatus) && WEXITSTATUS(nStatus) == 0;
+}
+
+/****************************************/
+/****************************************/
+
+int main(int n_argc, char** ppch_argv) {
+   std::vector<unsigned int> vecBlocks{16, 128, 1024};
+   std::vector<unsigned int> vecConditions{4, 32};
+   std::vector<unsigned int> vecPendingActions{0, 256};
+   std::string strEvaluation("polling");
+   std::string strLibrary(DI_SROCS_LOOP_FUNCTIONS_LIBRARY);
+   std::string strOutputFile;
+   unsigned int unTicks = 1000;
+   unsigned int unWarmupTicks = 100;
+   unsigned int unSeed = 12345;
+   bool bZeroAllocations = false;
+   int nOption;
+   while((nOption = ::getopt(n_argc, ppch_argv, "n:m:k:e:t:w:s:l:o:zh")) != -1) {
+      bool bValid = true;
+      switch(nOption) {
+         case 'n':
+            bValid = ParseList(optarg, vecBlocks);
+            break;
+         case 'm':
+            bValid = ParseList(optarg, vecConditions);
+            break;
+         case 'k':
+            bValid = ParseList(optarg, vecPendingActions);
+            break;
+         case 'e':
+            strEvaluation = optarg;
+            break;
+         case 't':
+            unTicks = std::strtoul(optarg, nullptr, 10);
+            break;
+         case 'w':
+            unWarmupTicks = std::strtoul(optarg, nullptr, 10);
+            break;
+         case 's':
+            unSeed = std::strtoul(optarg, nullptr, 10);
+            break;
+         case 'l':
+            strLibrary = optarg;
+            break;
+         case 'o':
+            strOutputFile = optarg;
+            break;
+         case 'z':
+            bZeroAllocations = true;
+            break;
+         default:
+            bValid = false;
+            break;
+      }
+      if(!bValid) {
+         PrintUsage(ppch_argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+   if(unTicks == 0 ||
+      (strEvaluation != "polling" && strEvaluation != "event" && strEvaluation != "verify")) {
+      PrintUsage(ppch_argv[0]);
+      return EXIT_FAILURE;
+   }
+   /* the configurations and the logs of the loop functions are written into a temporary directory */
+   char pchDirectory[] = "/tmp/di_srocs_benchmarks.XXXXXX";
+   if(::mkdtemp(pchDirectory) == nullptr) {
+      std::cerr << "[ERROR] Could not create a temporary directory" << std::endl;
+      return EXIT_FAILURE;
+   }
+   std::string strDirectory(pchDirectory);
+   std::string strConfiguration = strDirectory + "/benchmark.argos";
+   std::ofstream cOutput;
+   if(!strOutputFile.empty()) {
+      cOutput.open(strOutputFile);
+      if(!cOutput) {
+         std::cerr << "[ERROR] Could not open " << strOutputFile << std::endl;
+         return EXIT_FAILURE;
+      }
+      cOutput << "name,blocks,conditions,pending_actions,evaluation,ns_per_tick,allocations_per_tick"
+              << std::endl;
+   }
+   std::cout << std::left << std::setw(56) << "Benchmark"
+             << std::right << std::setw(14) << "ns/tick"
+             << std::setw(14) << "allocs/tick"
+             << std::setw(10) << "ticks" << std::endl
+             << std::string(94, '-') << std::endl;
+   unsigned int unFailed = 0;
+   for(unsigned int un_blocks : vecBlocks) {
+      for(unsigned int un_conditions : vecConditions) {
+         for(unsigned int un_pending_actions : vecPendingActions) {
+            SCase sCase{un_blocks, un_conditions, un_pending_actions};
+            std::ostringstream cName;
+            cName << "BM_Tick/" << strEvaluation
+                  << "/blocks:" << sCase.Blocks
+                  << "/conditions:" << sCase.Conditions
+                  << "/pending_actions:" << sCase.PendingActions;
+            std::ofstream(strConfiguration) <<
+               GenerateConfiguration(sCase, strLibrary, strEvaluation, strDirectory, unSeed);
+            /* warm up for at least k steps, so that the pending actions have accumulated */
+            SResult sResult;
+            if(!ForkCase(strConfiguration,
+                         std::max(unWarmupTicks, sCase.PendingActions + 1),
+                         unTicks,
+                         sResult)) {
+               std::cout << std::left << std::setw(56) << cName.str()
+                         << std::right << std::setw(38) << "FAILED" << std::endl;
+               unFailed++;
+               continue;
+            }
+            std::cout << std::left << std::setw(56) << cName.str()
+                      << std::right << std::fixed
+                      << std::setw(14) << std::setprecision(0) << sResult.NanosecondsPerTick
+                      << std::setw(14) << std::setprecision(2) << sResult.AllocationsPerTick
+                      << std::setw(10) << unTicks;
+            if(bZeroAllocations && sResult.AllocationsPerTick > 0.0) {
+               std::cout << "  ALLOCATES";
+               unFailed++;
+            }
+            std::cout << std::endl;
+            if(cOutput.is_open()) {
+               cOutput << cName.str() << ','
+                       << sCase.Blocks << ','
+                       << sCase.Conditions << ','
+                       << sCase.PendingActions << ','
+                       << strEvaluation << ','
+                       << sResult.NanosecondsPerTick << ','
+                       << sResult.AllocationsPerTick << std::endl;
+            }
+         }
+      }
+   }
+   /* clean up the temporary directory */
+   ::unlink(strConfiguration.c_str());
+   ::unlink((strDirectory + "/loop_functions.csv").c_str());
+   ::rmdir(strDirectory.c_str());
+   return (unFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/****************************************/
+/****************************************/
@@ -34,6 +34,12 @@ find_library(SROCS_ENTITIES_LIBRARY
   DOC "The SRoCS entity library"
 )
 
+find_library(ARGOS_CORE_LIBRARY
+  NAMES argos3core_${ARGOS_BUILD_FOR}
+  PATH_SUFFIXES argos3
+  DOC "The ARGoS core library"
+)
+
 find_library(ARGOS_QTOPENGL_LIBRARY
     NAMES argos3plugin_${ARGOS_BUILD_FOR}_qtopengl
     PATH_SUFFIXES argos3
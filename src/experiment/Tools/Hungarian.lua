@@ -99,6 +99,12 @@ end
 
 ----------------------------------------------------------------
 
+----------------------------------------------------------------
+-- the native solver built from lua_modules/di_srocs_hungarian.cpp, if it can be found in
+-- package.cpath, otherwise the Lua implementation below is used
+local nativeFound, NativeHungarian = pcall(require, "di_srocs_hungarian")
+if nativeFound ~= true then NativeHungarian = nil end
+
 ----------------------------------------------------------------
 -- Hungarian starts
    -- for the algorithm, please refer to: https://www.topcoder.com/community/data-science/data-science-tutorials/assignment-problem-and-hungarian-algorithm/
@@ -135,7 +141,6 @@ function Hungarian:create(configuration)
    -- Set costMat and size N
    --instance.costMat = deepcopy(configuration.costMat)
    local n,m = getNM_Mat(configuration.costMat)
-   instance.costMat = copy(configuration.costMat,n,m)
 
    -- check and get N
    if n == -1 or m == -1 then
@@ -150,6 +155,17 @@ function Hungarian:create(configuration)
    end
    instance.N = n
 
+   -- the native solver copies the costMat into its own arrays
+   if NativeHungarian ~= nil then
+      instance.costMat = configuration.costMat
+      instance.MAXorMIN = configuration.MAXorMIN
+      instance.maxMatch = 0
+      instance.match_of_X = {}
+      instance.match_of_Y = {}
+      return instance
+   end
+   instance.costMat = copy(configuration.costMat,n,m)
+
    ---------------- min or max problem ----------------
    if configuration.MAXorMIN == "MIN" then
       for i = 1,n do
@@ -241,6 +257,14 @@ function Hungarian:aug()
 
    -- OK already?
    if (self.maxMatch == self.N) then return 0 end
+
+   -- the native solver finds the whole match at once
+   if NativeHungarian ~= nil then
+      self.match_of_X, self.match_of_Y =
+         NativeHungarian.solve(self.costMat, self.N, self.MAXorMIN)
+      self.maxMatch = self.N
+      return
+   end
    local N = self.N
       -- write self.N everytime could be annoying, use N directly
 
@@ -1,5 +1,6 @@
 package.path = package.path .. ';Tools/?.lua'
 package.path = package.path .. ';AppNode/?.lua'
+package.cpath = package.cpath .. ';Tools/?.so'
 DebugMSG = require('DebugMessage')
 -- require('Debugger')
 
@@ -0,0 +1,499 @@
+#include "di_srocs_logger.h"
+#include "di_srocs_trace_format.h"
+
+#include <argos3/core/simulator/entity/embodied_entity.h>
+#include <argos3/core/utility/logging/argos_log.h>
+#include <argos3/plugins/simulator/entities/debug_entity.h>
+
+#include <algorithm>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   CDISRoCSLogger::SOutputStream::SOutputStream(const std::string& str_path,
+                                                size_t un_buffer_size,
+                                                std::ios_base::openmode e_mode) :
+      Buffer(new char[un_buffer_size]) {
+      /* the buffer can only be installed before the file is opened */
+      Stream.rdbuf()->pubsetbuf(Buffer.get(), un_buffer_size);
+      Stream.open(str_path, e_mode | std::ios_base::trunc);
+      if(!Stream.is_open()) {
+         THROW_ARGOSEXCEPTION("Could not open \"" << str_path << "\" for writing");
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CDISRoCSLogger::~CDISRoCSLogger() {
+      try {
+         Reset();
+      }
+      catch(CARGoSException& ex) {
+         /* a destructor must not throw */
+         LOGERR << "[WARNING] " << ex.what() << std::endl;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::Init(TConfigurationNode& t_tree) {
+      std::string strFormat("csv");
+      std::string strOverflow("block");
+      UInt32 unBufferSize = m_unBufferSize;
+      UInt32 unQueueSize = 1 << 16;
+      GetNodeAttributeOrDefault(t_tree, "format", strFormat, strFormat);
+      if(strFormat == "csv") {
+         m_eFormat = EFormat::CSV;
+         m_strPath = "loop_functions.csv";
+      }
+      else if(strFormat == "binary") {
+         m_eFormat = EFormat::BINARY;
+         m_strPath = "loop_functions.trace";
+      }
+      else {
+         THROW_ARGOSEXCEPTION("Log format \"" << strFormat << "\" not implemented.");
+      }
+      GetNodeAttributeOrDefault(t_tree, "interleaved", m_bInterleaved, m_bInterleaved);
+      GetNodeAttributeOrDefault(t_tree, "file", m_strPath, m_strPath);
+      GetNodeAttributeOrDefault(t_tree, "prefix", m_strPrefix, m_strPrefix);
+      GetNodeAttributeOrDefault(t_tree, "buffer_size", unBufferSize, unBufferSize);
+      GetNodeAttributeOrDefault(t_tree, "block_records", m_unBlockRecords, m_unBlockRecords);
+      GetNodeAttributeOrDefault(t_tree, "flush_interval", m_unFlushInterval, m_unFlushInterval);
+      GetNodeAttributeOrDefault(t_tree, "asynchronous", m_bAsynchronous, m_bAsynchronous);
+      GetNodeAttributeOrDefault(t_tree, "queue_size", unQueueSize, unQueueSize);
+      GetNodeAttributeOrDefault(t_tree, "overflow", strOverflow, strOverflow);
+      if(unBufferSize == 0) {
+         THROW_ARGOSEXCEPTION("The buffer size of the log must be greater than zero");
+      }
+      if(m_unBlockRecords == 0) {
+         THROW_ARGOSEXCEPTION("The number of records per block must be greater than zero");
+      }
+      if(strOverflow == "block") {
+         m_eOverflow = EOverflow::BLOCK;
+      }
+      else if(strOverflow == "drop") {
+         m_eOverflow = EOverflow::DROP;
+      }
+      else {
+         THROW_ARGOSEXCEPTION("Log overflow policy \"" << strOverflow << "\" not implemented.");
+      }
+      if(m_bAsynchronous) {
+         if(unQueueSize == 0) {
+            THROW_ARGOSEXCEPTION("The queue size of the log must be greater than zero");
+         }
+         /* preallocate the ring buffer, the strings of the records are reused */
+         m_vecQueue.resize(unQueueSize);
+      }
+      m_unBufferSize = unBufferSize;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::Reset() {
+      StopWriter();
+      /* destroying the sink flushes and closes the files */
+      m_ptrSink.reset();
+      m_unStepsSinceFlush = 0;
+      if(m_unDroppedRecords != 0) {
+         LOGERR << "[WARNING] "
+                << m_unDroppedRecords
+                << " log records were dropped since the queue of the writer thread was full"
+                << std::endl;
+         m_unDroppedRecords = 0;
+      }
+      RethrowWriterError();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::Log(UInt32 un_clock,
+                            const std::string& str_entity_id,
+                            const CEmbodiedEntity& c_embodied_entity,
+                            const CDebugEntity& c_debug_entity) {
+      const SAnchor& sOriginAnchor = c_embodied_entity.GetOriginAnchor();
+      if(!m_bAsynchronous) {
+         if(!m_ptrSink) {
+            CreateSink();
+         }
+         m_ptrSink->Write(un_clock,
+                          str_entity_id,
+                          sOriginAnchor.Position,
+                          sOriginAnchor.Orientation,
+                          c_debug_entity.GetBuffer("loop_functions"));
+         return;
+      }
+      RethrowWriterError();
+      if(!m_cWriterThread.joinable()) {
+         StartWriter();
+      }
+      size_t unTail = m_unQueueTail.load(std::memory_order_relaxed);
+      if(unTail - m_unQueueHead.load(std::memory_order_acquire) == m_vecQueue.size()) {
+         if(m_eOverflow == EOverflow::DROP) {
+            m_unDroppedRecords++;
+            return;
+         }
+         std::unique_lock<std::mutex> cLock(m_mtxQueue);
+         m_cvQueueNotEmpty.notify_one();
+         m_cvQueueNotFull.wait(cLock, [this, unTail] {
+            return unTail - m_unQueueHead.load(std::memory_order_acquire) < m_vecQueue.size() ||
+                   m_bWriterFailed.load(std::memory_order_acquire);
+         });
+         cLock.unlock();
+         /* the writer thread will not drain the queue anymore */
+         RethrowWriterError();
+      }
+      /* the slot between the head and the tail belongs to this thread until the tail is moved */
+      SRecord& sRecord = m_vecQueue[unTail % m_vecQueue.size()];
+      sRecord.Clock = un_clock;
+      sRecord.EntityId.assign(str_entity_id);
+      sRecord.Position = sOriginAnchor.Position;
+      sRecord.Orientation = sOriginAnchor.Orientation;
+      sRecord.Buffer.assign(c_debug_entity.GetBuffer("loop_functions"));
+      m_unQueueTail.store(unTail + 1, std::memory_order_release);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::EndStep() {
+      RethrowWriterError();
+      if(m_unFlushInterval != 0 && ++m_unStepsSinceFlush >= m_unFlushInterval) {
+         Flush();
+      }
+      else if(m_cWriterThread.joinable()) {
+         /* wake up the writer thread once per step rather than once per record */
+         { std::lock_guard<std::mutex> cLock(m_mtxQueue); }
+         m_cvQueueNotEmpty.notify_one();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::Flush() {
+      if(m_cWriterThread.joinable()) {
+         /* the sink belongs to the writer thread, ask it to flush once it has drained the queue */
+         m_bFlushRequested.store(true);
+         { std::lock_guard<std::mutex> cLock(m_mtxQueue); }
+         m_cvQueueNotEmpty.notify_one();
+      }
+      else if(m_ptrSink) {
+         m_ptrSink->Flush();
+      }
+      m_unStepsSinceFlush = 0;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::CreateSink() {
+      if(m_eFormat == EFormat::BINARY) {
+         m_ptrSink = std::make_unique<CBinarySink>(m_strPrefix + m_strPath, m_unBufferSize, m_unBlockRecords);
+      }
+      else {
+         m_ptrSink = std::make_unique<CCSVSink>(m_bInterleaved, m_strPrefix, m_strPath, m_unBufferSize);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::StartWriter() {
+      /* create the sink on this thread so that errors opening the binary trace are thrown here,
+         the files of the CSV sink are opened on the writer thread, whose errors are rethrown by
+         the next call to Log, EndStep or Reset */
+      if(!m_ptrSink) {
+         CreateSink();
+      }
+      m_unQueueHead.store(0);
+      m_unQueueTail.store(0);
+      m_bFlushRequested.store(false);
+      m_bStopRequested.store(false);
+      m_cWriterThread = std::thread(&CDISRoCSLogger::WriterThread, this);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::StopWriter() {
+      if(!m_cWriterThread.joinable()) {
+         return;
+      }
+      {
+         std::lock_guard<std::mutex> cLock(m_mtxQueue);
+         m_bStopRequested.store(true);
+      }
+      m_cvQueueNotEmpty.notify_one();
+      m_cWriterThread.join();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::WriterThread() {
+      try {
+         size_t unHead = m_unQueueHead.load(std::memory_order_relaxed);
+         for(;;) {
+            size_t unTail = m_unQueueTail.load(std::memory_order_acquire);
+            if(unHead == unTail) {
+               if(m_bFlushRequested.exchange(false)) {
+                  m_ptrSink->Flush();
+               }
+               std::unique_lock<std::mutex> cLock(m_mtxQueue);
+               m_cvQueueNotEmpty.wait(cLock, [this, unHead] {
+                  return m_unQueueTail.load(std::memory_order_acquire) != unHead ||
+                         m_bFlushRequested.load() ||
+                         m_bStopRequested.load();
+               });
+               if(m_bStopRequested.load() &&
+                  m_unQueueTail.load(std::memory_order_acquire) == unHead) {
+                  /* the queue has been drained */
+                  break;
+               }
+               continue;
+            }
+            for(; unHead != unTail; unHead++) {
+               const SRecord& sRecord = m_vecQueue[unHead % m_vecQueue.size()];
+               m_ptrSink->Write(sRecord.Clock,
+                                sRecord.EntityId,
+                                sRecord.Position,
+                                sRecord.Orientation,
+                                sRecord.Buffer);
+            }
+            /* hand the slots back to the simulation thread */
+            m_unQueueHead.store(unHead, std::memory_order_release);
+            { std::lock_guard<std::mutex> cLock(m_mtxQueue); }
+            m_cvQueueNotFull.notify_one();
+         }
+         m_ptrSink->Flush();
+      }
+      catch(...) {
+         /* stop draining the queue and hand the error to the simulation thread */
+         m_ptrWriterError = std::current_exception();
+         m_bWriterFailed.store(true, std::memory_order_release);
+         { std::lock_guard<std::mutex> cLock(m_mtxQueue); }
+         m_cvQueueNotFull.notify_one();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::RethrowWriterError() {
+      if(!m_bWriterFailed.load(std::memory_order_acquire)) {
+         return;
+      }
+      /* the writer thread has already stopped */
+      if(m_cWriterThread.joinable()) {
+         m_cWriterThread.join();
+      }
+      std::exception_ptr ptrWriterError = m_ptrWriterError;
+      m_ptrWriterError = nullptr;
+      m_bWriterFailed.store(false);
+      try {
+         std::rethrow_exception(ptrWriterError);
+      }
+      catch(CARGoSException& ex) {
+         THROW_ARGOSEXCEPTION_NESTED("The writer thread of the log failed", ex);
+      }
+      catch(std::exception& ex) {
+         THROW_ARGOSEXCEPTION("The writer thread of the log failed: " << ex.what());
+      }
+      catch(...) {
+         THROW_ARGOSEXCEPTION("The writer thread of the log failed");
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::CCSVSink::Write(UInt32 un_clock,
+                                        const std::string& str_entity_id,
+                                        const CVector3& c_position,
+                                        const CQuaternion& c_orientation,
+                                        const std::string& str_buffer) {
+      std::ofstream& cOutputStream = GetOutputStream(str_entity_id);
+      if(m_bInterleaved) {
+         cOutputStream << str_entity_id << ",";
+      }
+      cOutputStream
+         << un_clock
+         << ","
+         << c_position
+         << ",";
+      /* write the buffer without its newlines, segment by segment rather than through a copy */
+      std::string::size_type unStart = 0;
+      std::string::size_type unEnd;
+      while((unEnd = str_buffer.find('\n', unStart)) != std::string::npos) {
+         cOutputStream.write(str_buffer.data() + unStart, unEnd - unStart);
+         unStart = unEnd + 1;
+      }
+      cOutputStream.write(str_buffer.data() + unStart, str_buffer.size() - unStart);
+      /* newline rather than std::endl, the streams are flushed by the logger */
+      cOutputStream << '\n';
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::CCSVSink::Flush() {
+      for(std::pair<const std::string, std::unique_ptr<SOutputStream> >& c_output_stream :
+          m_mapOutputStreams) {
+         c_output_stream.second->Stream.flush();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   std::ofstream& CDISRoCSLogger::CCSVSink::GetOutputStream(const std::string& str_entity_id) {
+      const std::string& strKey = m_bInterleaved ? m_strPath : str_entity_id;
+      std::map<std::string, std::unique_ptr<SOutputStream> >::iterator itOutputStream =
+         m_mapOutputStreams.find(strKey);
+      if(itOutputStream == std::end(m_mapOutputStreams)) {
+         const std::string strPath = m_strPrefix + (m_bInterleaved ? strKey : (strKey + ".csv"));
+         std::pair<std::map<std::string, std::unique_ptr<SOutputStream> >::iterator, bool> cResult =
+            m_mapOutputStreams.emplace(strKey,
+                                       std::make_unique<SOutputStream>(strPath, m_unBufferSize));
+         if(cResult.second) {
+            itOutputStream = cResult.first;
+         }
+         else {
+            THROW_ARGOSEXCEPTION("Could not insert output stream into map");
+         }
+      }
+      return itOutputStream->second->Stream;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CDISRoCSLogger::CBinarySink::CBinarySink(const std::string& str_path,
+                                            size_t un_buffer_size,
+                                            UInt32 un_block_records) :
+      m_sOutputStream(str_path, un_buffer_size, std::ios_base::out | std::ios_base::binary),
+      m_unBlockRecords(un_block_records) {
+      for(std::vector<double>& vec_column : m_vecColumns) {
+         vec_column.reserve(m_unBlockRecords);
+      }
+      m_vecClock.reserve(m_unBlockRecords);
+      m_vecEntity.reserve(m_unBlockRecords);
+      m_vecString.reserve(m_unBlockRecords);
+      STraceFileHeader sHeader;
+      std::copy(std::begin(TRACE_MAGIC), std::end(TRACE_MAGIC), std::begin(sHeader.Magic));
+      sHeader.Version = TRACE_VERSION;
+      sHeader.Reserved = 0;
+      m_sOutputStream.Stream.write(reinterpret_cast<const char*>(&sHeader), sizeof(sHeader));
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CDISRoCSLogger::CBinarySink::~CBinarySink() {
+      WriteBlock();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::CBinarySink::Write(UInt32 un_clock,
+                                           const std::string& str_entity_id,
+                                           const CVector3& c_position,
+                                           const CQuaternion& c_orientation,
+                                           const std::string& str_buffer) {
+      /* the dictionary chunks must be written before the block that references them */
+      UInt32 unEntity =
+         GetIndex(m_mapEntityIds, static_cast<UInt32>(ETraceChunk::ENTITY), str_entity_id);
+      UInt32 unString =
+         GetIndex(m_mapStrings, static_cast<UInt32>(ETraceChunk::STRING), str_buffer);
+      m_vecColumns[0].push_back(c_position.GetX());
+      m_vecColumns[1].push_back(c_position.GetY());
+      m_vecColumns[2].push_back(c_position.GetZ());
+      m_vecColumns[3].push_back(c_orientation.GetW());
+      m_vecColumns[4].push_back(c_orientation.GetX());
+      m_vecColumns[5].push_back(c_orientation.GetY());
+      m_vecColumns[6].push_back(c_orientation.GetZ());
+      m_vecClock.push_back(un_clock);
+      m_vecEntity.push_back(unEntity);
+      m_vecString.push_back(unString);
+      if(m_vecClock.size() >= m_unBlockRecords) {
+         WriteBlock();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::CBinarySink::Flush() {
+      WriteBlock();
+      m_sOutputStream.Stream.flush();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CDISRoCSLogger::CBinarySink::GetIndex(std::unordered_map<std::string, UInt32>& map_table,
+                                                UInt32 un_chunk_type,
+                                                const std::string& str_value) {
+      std::unordered_map<std::string, UInt32>::iterator itEntry = map_table.find(str_value);
+      if(itEntry != std::end(map_table)) {
+         return itEntry->second;
+      }
+      UInt32 unIndex = map_table.size();
+      map_table.emplace(str_value, unIndex);
+      WriteChunkHeader(un_chunk_type, str_value.size(), unIndex);
+      static const char pchPadding[8] = {};
+      m_sOutputStream.Stream.write(str_value.data(), str_value.size());
+      m_sOutputStream.Stream.write(pchPadding, GetTracePadding(str_value.size()));
+      return unIndex;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::CBinarySink::WriteChunkHeader(UInt32 un_type,
+                                                      UInt32 un_size,
+                                                      UInt32 un_index) {
+      STraceChunkHeader sChunkHeader;
+      sChunkHeader.Type = un_type;
+      sChunkHeader.Size = un_size;
+      sChunkHeader.Index = un_index;
+      sChunkHeader.Reserved = 0;
+      m_sOutputStream.Stream.write(reinterpret_cast<const char*>(&sChunkHeader),
+                                   sizeof(sChunkHeader));
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLogger::CBinarySink::WriteBlock() {
+      UInt32 unRecords = m_vecClock.size();
+      if(unRecords == 0) {
+         return;
+      }
+      std::ofstream& cStream = m_sOutputStream.Stream;
+      WriteChunkHeader(static_cast<UInt32>(ETraceChunk::BLOCK), unRecords, 0);
+      for(std::vector<double>& vec_column : m_vecColumns) {
+         cStream.write(reinterpret_cast<const char*>(vec_column.data()),
+                       unRecords * sizeof(double));
+         vec_column.clear();
+      }
+      for(std::vector<UInt32>* pvec_column : {&m_vecClock, &m_vecEntity, &m_vecString}) {
+         cStream.write(reinterpret_cast<const char*>(pvec_column->data()),
+                       unRecords * sizeof(UInt32));
+         pvec_column->clear();
+      }
+      static const char pchPadding[8] = {};
+      cStream.write(pchPadding, GetTracePadding(unRecords * 3 * sizeof(UInt32)));
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
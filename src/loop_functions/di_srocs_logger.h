@@ -0,0 +1,210 @@
+#ifndef DI_SROCS_LOGGER_H
+#define DI_SROCS_LOGGER_H
+
+namespace argos {
+   class CEmbodiedEntity;
+   class CDebugEntity;
+}
+
+#include <argos3/core/utility/configuration/argos_configuration.h>
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <argos3/core/utility/math/vector3.h>
+#include <argos3/core/utility/math/quaternion.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace argos {
+
+   class CDISRoCSLogger {
+
+   public:
+
+      enum class EFormat {
+         CSV,
+         BINARY,
+      };
+
+      /* what the simulation thread does when the queue of the writer thread is full */
+      enum class EOverflow {
+         BLOCK,
+         DROP,
+      };
+
+   public:
+
+      CDISRoCSLogger() {}
+
+      ~CDISRoCSLogger();
+
+      void Init(TConfigurationNode& t_tree);
+
+      void Reset();
+
+      void Log(UInt32 un_clock,
+               const std::string& str_entity_id,
+               const CEmbodiedEntity& c_embodied_entity,
+               const CDebugEntity& c_debug_entity);
+
+      /* called once at the end of every step, flushes the streams every m_unFlushInterval ticks */
+      void EndStep();
+
+      void Flush();
+
+      /* the prefix of the paths of the log files */
+      const std::string& GetPrefix() const {
+         return m_strPrefix;
+      }
+
+   private:
+
+      /* a snapshot of an entity that is queued for the writer thread */
+      struct SRecord {
+         UInt32 Clock;
+         std::string EntityId;
+         CVector3 Position;
+         CQuaternion Orientation;
+         std::string Buffer;
+      };
+
+      struct SOutputStream {
+         SOutputStream(const std::string& str_path,
+                       size_t un_buffer_size,
+                       std::ios_base::openmode e_mode = std::ios_base::out);
+         /* the buffer must outlive the stream that uses it */
+         std::unique_ptr<char[]> Buffer;
+         std::ofstream Stream;
+      };
+
+      class CSink {
+      public:
+         virtual ~CSink() {}
+         virtual void Write(UInt32 un_clock,
+                            const std::string& str_entity_id,
+                            const CVector3& c_position,
+                            const CQuaternion& c_orientation,
+                            const std::string& str_buffer) = 0;
+         virtual void Flush() = 0;
+      };
+
+      class CCSVSink : public CSink {
+      public:
+         CCSVSink(bool b_interleaved,
+                  const std::string& str_prefix,
+                  const std::string& str_path,
+                  size_t un_buffer_size) :
+            m_bInterleaved(b_interleaved),
+            m_strPrefix(str_prefix),
+            m_strPath(str_path),
+            m_unBufferSize(un_buffer_size) {}
+         virtual void Write(UInt32 un_clock,
+                            const std::string& str_entity_id,
+                            const CVector3& c_position,
+                            const CQuaternion& c_orientation,
+                            const std::string& str_buffer) override;
+         virtual void Flush() override;
+      private:
+         std::ofstream& GetOutputStream(const std::string& str_entity_id);
+         bool m_bInterleaved;
+         std::string m_strPrefix;
+         std::string m_strPath;
+         size_t m_unBufferSize;
+         std::map<std::string, std::unique_ptr<SOutputStream> > m_mapOutputStreams;
+      };
+
+      class CBinarySink : public CSink {
+      public:
+         CBinarySink(const std::string& str_path,
+                     size_t un_buffer_size,
+                     UInt32 un_block_records);
+         virtual ~CBinarySink();
+         virtual void Write(UInt32 un_clock,
+                            const std::string& str_entity_id,
+                            const CVector3& c_position,
+                            const CQuaternion& c_orientation,
+                            const std::string& str_buffer) override;
+         virtual void Flush() override;
+      private:
+         UInt32 GetIndex(std::unordered_map<std::string, UInt32>& map_table,
+                         UInt32 un_chunk_type,
+                         const std::string& str_value);
+         void WriteChunkHeader(UInt32 un_type, UInt32 un_size, UInt32 un_index);
+         void WriteBlock();
+         SOutputStream m_sOutputStream;
+         UInt32 m_unBlockRecords;
+         /* dictionaries of the entity ids and of the debug buffers */
+         std::unordered_map<std::string, UInt32> m_mapEntityIds;
+         std::unordered_map<std::string, UInt32> m_mapStrings;
+         /* columns of the current block */
+         std::vector<double> m_vecColumns[7];
+         std::vector<UInt32> m_vecClock;
+         std::vector<UInt32> m_vecEntity;
+         std::vector<UInt32> m_vecString;
+      };
+
+   private:
+
+      void CreateSink();
+
+      void StartWriter();
+
+      /* drains the queue, closes the sink and joins the writer thread */
+      void StopWriter();
+
+      void WriterThread();
+
+      /* joins the writer thread after it failed and rethrows its error */
+      void RethrowWriterError();
+
+   private:
+
+      EFormat m_eFormat = EFormat::CSV;
+      /* write all entities into a single file instead of one file per entity */
+      bool m_bInterleaved = false;
+      std::string m_strPath;
+      /* prepended to the paths of all files, e.g., to separate the output of different runs */
+      std::string m_strPrefix;
+      /* size of the buffer of each output stream in bytes */
+      size_t m_unBufferSize = 1 << 16;
+      /* number of records per column block in the binary format */
+      UInt32 m_unBlockRecords = 4096;
+      /* number of steps between flushes, zero means only flush on reset/destruction */
+      UInt32 m_unFlushInterval = 100;
+      UInt32 m_unStepsSinceFlush = 0;
+
+      /* created on the first write so that no files are created until something is logged */
+      std::unique_ptr<CSink> m_ptrSink;
+
+      /* asynchronous mode, the simulation thread only copies the records into a ring
+         buffer which is drained by a dedicated writer thread that owns the sink */
+      bool m_bAsynchronous = false;
+      EOverflow m_eOverflow = EOverflow::BLOCK;
+      std::vector<SRecord> m_vecQueue;
+      /* the head is only written by the writer thread and the tail by the simulation thread */
+      std::atomic<size_t> m_unQueueHead{0};
+      std::atomic<size_t> m_unQueueTail{0};
+      std::atomic<bool> m_bFlushRequested{false};
+      std::atomic<bool> m_bStopRequested{false};
+      std::mutex m_mtxQueue;
+      std::condition_variable m_cvQueueNotEmpty;
+      std::condition_variable m_cvQueueNotFull;
+      std::thread m_cWriterThread;
+      /* set by the writer thread before it stops on an error, e.g., a file that can not be opened */
+      std::exception_ptr m_ptrWriterError;
+      std::atomic<bool> m_bWriterFailed{false};
+      UInt64 m_unDroppedRecords = 0;
+
+   };
+
+}
+
+#endif
@@ -1,20 +1,159 @@
 #include "di_srocs_loop_functions.h"
 
+#include <argos3/core/simulator/simulator.h>
+#include <argos3/core/simulator/physics_engine/physics_engine.h>
 #include <argos3/plugins/simulator/entities/debug_entity.h>
+#include <argos3/plugins/simulator/entities/directional_led_entity.h>
+#include <argos3/plugins/simulator/entities/directional_led_equipped_entity.h>
 #include <argos3/plugins/simulator/entities/block_entity.h>
 #include <argos3/plugins/robots/builderbot/simulator/builderbot_entity.h>
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
 namespace argos {
 
    /****************************************/
    /****************************************/
 
-   CDISRoCSLoopFunctions::CDISRoCSLoopFunctions() {}
+   CDISRoCSLoopFunctions::CDISRoCSLoopFunctions() {
+      /* intern the types that are logged first so that they are at the front of the sorted snapshots */
+      m_mapEntityTypeIds.emplace("builderbot", BUILDERBOT_TYPE_ID);
+      m_mapEntityTypeIds.emplace("block", BLOCK_TYPE_ID);
+      /* the origin of a block is at the center of its bottom face */
+      SEntityExtents& sBlockExtents = GetEntityExtents(BLOCK_TYPE_ID);
+      sBlockExtents.Known = true;
+      sBlockExtents.MinCorner.Set(-0.0275, -0.0275, 0.0);
+      sBlockExtents.MaxCorner.Set(0.0275, 0.0275, 0.055);
+      m_fMaxEntityExtent = sBlockExtents.MaxCorner.Length();
+#ifdef DI_SROCS_PROFILING
+      m_unProfileSnapshots = m_cProfiler.Register("phase:snapshots");
+      m_unProfileConditions = m_cProfiler.Register("phase:conditions");
+      m_unProfileActions = m_cProfiler.Register("phase:actions");
+      m_unProfileLogging = m_cProfiler.Register("phase:logging");
+      m_unProfileMetrics = m_cProfiler.Register("phase:metrics");
+      m_unProfileEntityConditions = m_cProfiler.Register("condition:entity");
+      m_unProfileTimerConditions = m_cProfiler.Register("condition:timer");
+      m_unProfileLatticeConditions = m_cProfiler.Register("condition:lattice");
+      m_unProfileOtherConditions = m_cProfiler.Register("condition:other");
+#endif
+   }
 
    /****************************************/
    /****************************************/
 
    void CDISRoCSLoopFunctions::Init(TConfigurationNode& t_tree) {
+      /* configure the logger */
+      if(NodeExists(t_tree, "log")) {
+         m_cLogger.Init(GetNode(t_tree, "log"));
+      }
+      /* configure the metrics, their file shares the prefix of the log */
+      if(NodeExists(t_tree, "metrics")) {
+         m_cMetrics.Init(GetNode(t_tree, "metrics"),
+                         m_cLogger.GetPrefix(),
+                         60.0 * CPhysicsEngine::GetInverseSimulationClockTick());
+      }
+      /* configure the spatial index */
+      Real fCellSize = 0.1;
+      if(NodeExists(t_tree, "spatial_index")) {
+         GetNodeAttributeOrDefault(GetNode(t_tree, "spatial_index"), "cell_size", fCellSize, fCellSize);
+      }
+      m_cSpatialIndex.Init(GetSpace().GetArenaCenter(), GetSpace().GetArenaSize(), fCellSize);
+      /* configure the block lattice */
+      if(NodeExists(t_tree, "lattice")) {
+         TConfigurationNode& tLattice = GetNode(t_tree, "lattice");
+         GetNodeAttributeOrDefault(tLattice, "origin", m_cLatticeOrigin, m_cLatticeOrigin);
+         GetNodeAttributeOrDefault(tLattice, "tolerance", m_fLatticeTolerance, m_fLatticeTolerance);
+         /* the lattice index only visits the cell centered on a lattice point */
+         if(m_fLatticeTolerance <= 0.0 ||
+            m_fLatticeTolerance > 0.5 * CDISRoCSMetrics::BLOCK_SIDE_LENGTH) {
+            THROW_ARGOSEXCEPTION("The lattice tolerance must be greater than zero and at most " <<
+                                 0.5 * CDISRoCSMetrics::BLOCK_SIDE_LENGTH);
+         }
+      }
+      /* align the cells of the lattice index with the lattice points, covering the arena */
+      CVector3 cLatticeMinCorner =
+         SnapToLattice(GetSpace().GetArenaCenter() - GetSpace().GetArenaSize() * 0.5);
+      CVector3 cLatticeMaxCorner =
+         SnapToLattice(GetSpace().GetArenaCenter() + GetSpace().GetArenaSize() * 0.5);
+      m_cLatticeIndex.Init((cLatticeMinCorner + cLatticeMaxCorner) * 0.5,
+                           cLatticeMaxCorner - cLatticeMinCorner +
+                           CVector3(1.0, 1.0, 1.0) * CDISRoCSMetrics::BLOCK_SIDE_LENGTH,
+                           CDISRoCSMetrics::BLOCK_SIDE_LENGTH);
+      /* configure the profiler */
+      if(NodeExists(t_tree, "profile")) {
+#ifdef DI_SROCS_PROFILING
+         m_strProfileFile = "profile.csv";
+         GetNodeAttributeOrDefault(GetNode(t_tree, "profile"), "file", m_strProfileFile, m_strProfileFile);
+#else
+         LOGERR << "[WARNING] Ignoring the profile configuration since the loop functions "
+                << "were compiled without DI_SROCS_PROFILING"
+                << std::endl;
+#endif
+      }
+      /* configure saving and restoring the state */
+      if(NodeExists(t_tree, "state")) {
+         TConfigurationNode& tState = GetNode(t_tree, "state");
+         std::string strRestoreFile;
+         GetNodeAttributeOrDefault(tState, "save_at", m_unSaveStateAt, m_unSaveStateAt);
+         GetNodeAttributeOrDefault(tState, "file", m_strStateFile, m_strStateFile);
+         GetNodeAttributeOrDefault(tState, "restore", strRestoreFile, strRestoreFile);
+         GetNodeAttributeOrDefault(tState, "restore_on_reset", m_bRestoreStateOnReset, m_bRestoreStateOnReset);
+         if(!strRestoreFile.empty()) {
+            std::ifstream cStateFile(strRestoreFile);
+            if(!cStateFile) {
+               THROW_ARGOSEXCEPTION("Could not open the state file \"" << strRestoreFile << "\"");
+            }
+            std::ostringstream cState;
+            cState << cStateFile.rdbuf();
+            RestoreState(cState.str());
+            /* the restored state is also the state to return to on reset */
+            m_strSavedState = m_strPendingState;
+         }
+      }
+      /* configure how the conditions are evaluated */
+      std::string strEvaluation("polling");
+      GetNodeAttributeOrDefault(t_tree, "evaluation", strEvaluation, strEvaluation);
+      if(strEvaluation == "polling") {
+         m_eEvaluation = EEvaluation::POLLING;
+      }
+      else if(strEvaluation == "event") {
+         m_eEvaluation = EEvaluation::EVENT;
+      }
+      else if(strEvaluation == "verify") {
+         m_eEvaluation = EEvaluation::VERIFY;
+      }
+      else {
+         THROW_ARGOSEXCEPTION("Loop function evaluation \"" << strEvaluation << "\" not implemented.");
+      }
+      /* configure the parallel evaluation of the conditions, by default the loop functions use
+         as many threads as the simulator */
+      UInt32 unThreads = CSimulator::GetInstance().GetNumThreads();
+      if(NodeExists(t_tree, "parallel")) {
+         TConfigurationNode& tParallel = GetNode(t_tree, "parallel");
+         GetNodeAttributeOrDefault(tParallel, "threads", unThreads, unThreads);
+         GetNodeAttributeOrDefault(tParallel, "grain", m_unParallelGrain, m_unParallelGrain);
+      }
+      if(unThreads > 1) {
+#ifdef DI_SROCS_PROFILING
+         LOGERR << "[WARNING] Evaluating the conditions serially since the loop functions "
+                << "were compiled with DI_SROCS_PROFILING"
+                << std::endl;
+#else
+         /* the verification mode shares the polling flag between all conditions */
+         if(m_eEvaluation == EEvaluation::VERIFY) {
+            LOGERR << "[WARNING] Evaluating the conditions serially in the verification mode"
+                   << std::endl;
+         }
+         else {
+            /* the thread calling PreStep is the first thread of the pool */
+            m_cThreadPool.Start(unThreads - 1);
+         }
+#endif
+      }
       /* parse loop function configuration */
       TConfigurationNodeIterator itCondition("condition");
       for(itCondition = itCondition.begin(&t_tree);
@@ -23,6 +162,21 @@ namespace argos {
          /* parse the condition */
          m_vecConditions.emplace_back(ParseCondition(*itCondition));
       }
+      /* index the entity conditions by position so that moving entities only invalidate the
+         conditions that are nearby */
+      m_cEntityConditionIndex.Init(GetSpace().GetArenaCenter(), GetSpace().GetArenaSize(), fCellSize);
+      m_cEntityConditionIndex.Clear(m_vecEntityConditions.size());
+      for(UInt32 unIndex = 0; unIndex < m_vecEntityConditions.size(); unIndex++) {
+         m_cEntityConditionIndex.Insert(unIndex, m_vecEntityConditions[unIndex]->Position);
+      }
+      /* compile the conditions into a single program */
+      m_vecProgram.clear();
+      m_vecProgramEntries.clear();
+      for(std::unique_ptr<SCondition>& ptr_condition : m_vecConditions) {
+         m_vecProgramEntries.push_back(m_vecProgram.size());
+         CompileCondition(*ptr_condition);
+         m_vecProgram.push_back(SInstruction{SInstruction::EOpcode::RETURN, 0, nullptr});
+      }
    }
 
    /****************************************/
@@ -30,20 +184,73 @@ namespace argos {
 
    void CDISRoCSLoopFunctions::Reset() {
       /* remove all dynamically added entities */
-      for(CEntity* pc_entity : m_vecAddedEntities) {
-         CallEntityOperation<CSpaceOperationRemoveEntity, CSpace, void>(GetSpace(), *pc_entity);
+      for(SAddedEntity& s_added_entity : m_vecAddedEntities) {
+         CallEntityOperation<CSpaceOperationRemoveEntity, CSpace, void>(GetSpace(), *s_added_entity.Entity);
       }
       m_vecAddedEntities.clear();
+      /* the snapshots are rebuilt on the next step */
+      m_vecEntitySnapshots.clear();
+      m_vecFreeEntitySnapshots.clear();
+      m_mapEntitySnapshots.clear();
+      m_vecSortedEntitySnapshots.clear();
+      m_vecRootEntities.clear();
       /* clear is experiment finished */
       m_bTerminate = false;
-      /* clear map of timers */
-      m_mapTimers.clear();
-      /* clear output streams */
-      m_mapOutputStreams.clear();
+      /* stop all timers */
+      for(STimer& s_timer : m_vecTimers) {
+         s_timer.Running = false;
+      }
+      m_cTimerEvents.Clear();
+      /* discard the actions that were scheduled before the reset */
+      m_cPendingActions.Clear();
+      /* flush and close output streams */
+      m_cLogger.Reset();
+      m_cMetrics.Reset();
       /* reenable all conditions */
       for(std::unique_ptr<SCondition>& ptr_condition : m_vecConditions) {
          ptr_condition->Enabled = true;
       }
+      InvalidateConditions();
+      /* allocate the same ids as in the previous run */
+      for(SAddEntityAction* ps_action : m_vecAddEntityActions) {
+         ps_action->NextSuffix = 0;
+      }
+      /* continue from the saved state instead of starting from scratch */
+      if(m_bRestoreStateOnReset && !m_strSavedState.empty()) {
+         RestoreState(m_strSavedState);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::Destroy() {
+      m_cThreadPool.Stop();
+      m_cMetrics.Reset();
+#ifdef DI_SROCS_PROFILING
+      if(!m_strProfileFile.empty()) {
+         m_cProfiler.Write(m_strProfileFile);
+      }
+#endif
+      /* report the spawn statistics of the add_entity actions */
+      for(SAddEntityAction* ps_action : m_vecAddEntityActions) {
+         UInt32 unAttempts = ps_action->Spawned + ps_action->Failed;
+         if(unAttempts == 0) {
+            continue;
+         }
+         LOG << "[INFO] Added "
+             << ps_action->Spawned
+             << " of "
+             << unAttempts
+             << " entities from template \""
+             << ps_action->BaseId
+             << "\", mean latency "
+             << (ps_action->TotalLatency / unAttempts)
+             << " us, max latency "
+             << ps_action->MaxLatency
+             << " us"
+             << std::endl;
+      }
    }
 
    /****************************************/
@@ -51,59 +258,109 @@ namespace argos {
 
    void CDISRoCSLoopFunctions::PreStep() {
       UInt32 unClock = GetSpace().GetSimulationClock();
-      /* increment all timers */
-      for(std::pair<const std::string, UInt32>& c_timer : m_mapTimers) {
-         std::get<UInt32>(c_timer)++;
+      m_unClock = unClock;
+      if(!m_strPendingState.empty()) {
+         /* the state continues from the end of the previous step */
+         std::istringstream cState(m_strPendingState);
+         LoadState(cState, unClock - 1);
+         m_strPendingState.clear();
       }
-      /* check conditions */
-      for(std::unique_ptr<SCondition>& ptr_condition : m_vecConditions) {
-         if(ptr_condition->Enabled && ptr_condition->IsTrue()) {
-            /* schedule the associated actions */
-            for(const std::shared_ptr<SAction>& ptr_action : ptr_condition->Actions) {
-               m_mapPendingActions.emplace(unClock + ptr_action->Delay, ptr_action);
+      {
+         DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileSnapshots);
+         UpdateEntitySnapshots();
+      }
+      {
+         DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileConditions);
+         /* invalidate the timer conditions that could have changed on this step */
+         m_cTimerEvents.Expire(unClock, [this] (const STimerEvent& s_event) {
+            if(m_vecTimers[s_event.Condition->TimerSlot].Generation == s_event.Generation) {
+               s_event.Condition->Invalidate();
+            }
+         });
+         /* check conditions, the evaluation only reads the state of the simulation and writes
+            the caches of the condition that is evaluated, so the conditions are independent */
+         UInt32 unConditions = m_vecConditions.size();
+         m_vecConditionResults.resize(unConditions);
+         auto fnEvaluate = [this] (UInt32 un_condition) {
+            m_vecConditionResults[un_condition] =
+               m_vecConditions[un_condition]->Enabled && EvaluateCondition(un_condition);
+         };
+         if(m_cThreadPool.GetSize() > 1 && unConditions > m_unParallelGrain) {
+            m_cThreadPool.ParallelFor(unConditions, m_unParallelGrain, fnEvaluate);
+         }
+         else {
+            for(UInt32 unCondition = 0; unCondition < unConditions; unCondition++) {
+               fnEvaluate(unCondition);
             }
-            if(ptr_condition->Once) {
-               ptr_condition->Enabled = false;
+         }
+         /* schedule the actions in the order of the conditions */
+         for(UInt32 unCondition = 0; unCondition < unConditions; unCondition++) {
+            std::unique_ptr<SCondition>& ptr_condition = m_vecConditions[unCondition];
+            if(m_vecConditionResults[unCondition] != 0) {
+               /* schedule the associated actions */
+               for(const std::unique_ptr<SAction>& ptr_action : ptr_condition->Actions) {
+                  m_cPendingActions.Schedule(unClock + ptr_action->Delay, ptr_action.get());
+               }
+               if(ptr_condition->Once) {
+                  ptr_condition->Enabled = false;
+               }
             }
          }
       }
-      /* execute actions for the current timestep */
-      std::pair<std::multimap<UInt32, std::shared_ptr<SAction> >::iterator,
-                std::multimap<UInt32, std::shared_ptr<SAction> >::iterator> cActionRange =
-         m_mapPendingActions.equal_range(unClock);
-      for(std::multimap<UInt32, std::shared_ptr<SAction> >::iterator itAction = cActionRange.first;
-          itAction != cActionRange.second;
-          ++itAction) {
-         itAction->second->Execute();
+      {
+         DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileActions);
+         /* execute actions for the current timestep in the order in which they were scheduled */
+         m_cPendingActions.Expire(unClock, [&] (SAction* ps_action) {
+            DI_SROCS_PROFILE_SCOPE(m_cProfiler, ps_action->ProfileStatistic);
+            ps_action->Execute();
+         });
       }
-      m_mapPendingActions.erase(unClock);
    }
 
    /****************************************/
    /****************************************/
 
    void CDISRoCSLoopFunctions::PostStep() {
-      using TValueType = std::pair<const std::string, CAny>;
-      try {
-         for(TValueType& t_robot : GetSpace().GetEntitiesByType("builderbot")) {
-            CBuilderBotEntity* pcBuilderBot =
-               any_cast<CBuilderBotEntity*>(t_robot.second);
-            LogEntityToFile(t_robot.first,
-                            pcBuilderBot->GetEmbodiedEntity(),
-                            pcBuilderBot->GetDebugEntity());
+      UInt32 unClock = GetSpace().GetSimulationClock();
+      {
+         DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileSnapshots);
+         UpdateEntitySnapshots();
+      }
+      {
+         DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileLogging);
+         /* the builderbots and blocks are logged in the order of their ids */
+         for(UInt32 un_index : m_vecSortedEntitySnapshots) {
+            const SEntitySnapshot& sSnapshot = m_vecEntitySnapshots[un_index];
+            if(sSnapshot.TypeId != BUILDERBOT_TYPE_ID &&
+               sSnapshot.TypeId != BLOCK_TYPE_ID) {
+               break;
+            }
+            if(sSnapshot.EmbodiedEntity != nullptr && sSnapshot.DebugEntity != nullptr) {
+               m_cLogger.Log(unClock,
+                             sSnapshot.Entity->GetId(),
+                             *sSnapshot.EmbodiedEntity,
+                             *sSnapshot.DebugEntity);
+            }
          }
+         m_cLogger.EndStep();
       }
-      catch(CARGoSException &ex) {}
-      try {
-         for(TValueType& t_block : GetSpace().GetEntitiesByType("block")) {
-            CBlockEntity* pcBlock =
-               any_cast<CBlockEntity*>(t_block.second);
-            LogEntityToFile(t_block.first,
-                            pcBlock->GetEmbodiedEntity(),
-                            pcBlock->GetDebugEntity());
+      if(m_cMetrics.IsDue(unClock)) {
+         DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileMetrics);
+         UpdateMetrics(unClock);
+      }
+      /* save the state once, so that the following runs can continue from it */
+      if(unClock == m_unSaveStateAt && m_strSavedState.empty()) {
+         std::ostringstream cState;
+         SaveState(cState);
+         m_strSavedState = cState.str();
+         if(!m_strStateFile.empty()) {
+            std::ofstream cStateFile(m_strStateFile);
+            if(!cStateFile) {
+               THROW_ARGOSEXCEPTION("Could not open the state file \"" << m_strStateFile << "\"");
+            }
+            cStateFile << m_strSavedState;
          }
       }
-      catch(CARGoSException &ex) {}
    }
    
    /****************************************/
@@ -113,12 +370,214 @@ namespace argos {
       return m_bTerminate;
    }
 
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::SaveState(std::ostream& c_stream) const {
+      /* a text format, all ticks are relative to the last step */
+      c_stream << std::setprecision(17);
+      c_stream << "di_srocs_state 1" << std::endl;
+      c_stream << "terminate " << m_bTerminate << std::endl;
+      c_stream << "timers " << m_mapTimerSlots.size() << std::endl;
+      for(const std::pair<const std::string, UInt32>& c_timer_slot : m_mapTimerSlots) {
+         const STimer& sTimer = m_vecTimers[c_timer_slot.second];
+         c_stream << std::quoted(c_timer_slot.first) << ' '
+                  << sTimer.Running << ' '
+                  << (m_unClock - sTimer.Start) << std::endl;
+      }
+      c_stream << "conditions " << m_vecConditions.size() << std::endl;
+      for(const std::unique_ptr<SCondition>& ptr_condition : m_vecConditions) {
+         c_stream << ptr_condition->Enabled << std::endl;
+      }
+      c_stream << "add_entity_actions " << m_vecAddEntityActions.size() << std::endl;
+      for(const SAddEntityAction* ps_action : m_vecAddEntityActions) {
+         c_stream << ps_action->NextSuffix << std::endl;
+      }
+      std::unordered_map<const SAction*, UInt32> mapActionIndices;
+      for(UInt32 unIndex = 0; unIndex < m_vecActions.size(); unIndex++) {
+         mapActionIndices.emplace(m_vecActions[unIndex], unIndex);
+      }
+      /* the actions for the last step have already been executed */
+      std::ostringstream cPendingActions;
+      UInt32 unPendingActions = 0;
+      m_cPendingActions.ForEach([&] (UInt32 un_tick, const SAction* ps_action) {
+         if(un_tick > m_unClock) {
+            cPendingActions << (un_tick - m_unClock) << ' '
+                            << mapActionIndices.at(ps_action) << std::endl;
+            unPendingActions++;
+         }
+      });
+      c_stream << "pending_actions " << unPendingActions << std::endl;
+      c_stream << cPendingActions.str();
+      c_stream << "added_entities " << m_vecAddedEntities.size() << std::endl;
+      for(const SAddedEntity& s_added_entity : m_vecAddedEntities) {
+         c_stream << mapActionIndices.at(s_added_entity.Action) << ' '
+                  << std::quoted(s_added_entity.Entity->GetId());
+         CComposableEntity* pcComposableEntity =
+            dynamic_cast<CComposableEntity*>(s_added_entity.Entity);
+         if(pcComposableEntity != nullptr && pcComposableEntity->HasComponent("body")) {
+            const SAnchor& sOriginAnchor =
+               pcComposableEntity->GetComponent<CEmbodiedEntity>("body").GetOriginAnchor();
+            c_stream << " 1 "
+                     << sOriginAnchor.Position.GetX() << ' '
+                     << sOriginAnchor.Position.GetY() << ' '
+                     << sOriginAnchor.Position.GetZ() << ' '
+                     << sOriginAnchor.Orientation.GetW() << ' '
+                     << sOriginAnchor.Orientation.GetX() << ' '
+                     << sOriginAnchor.Orientation.GetY() << ' '
+                     << sOriginAnchor.Orientation.GetZ();
+         }
+         else {
+            c_stream << " 0";
+         }
+         c_stream << std::endl;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::RestoreState(const std::string& str_state) {
+      m_strPendingState = str_state;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::LoadState(std::istream& c_stream, UInt32 un_clock) {
+      auto fnExpect = [&c_stream] (const std::string& str_expected) {
+         std::string strToken;
+         c_stream >> strToken;
+         if(strToken != str_expected) {
+            THROW_ARGOSEXCEPTION("Expected \"" << str_expected << "\" in the loop function state but found \"" <<
+                                 strToken << "\"");
+         }
+      };
+      UInt32 unVersion = 0;
+      UInt32 unCount = 0;
+      fnExpect("di_srocs_state");
+      c_stream >> unVersion;
+      if(unVersion != 1) {
+         THROW_ARGOSEXCEPTION("Loop function state version " << unVersion << " not implemented.");
+      }
+      fnExpect("terminate");
+      c_stream >> m_bTerminate;
+      /* timers */
+      for(STimer& s_timer : m_vecTimers) {
+         s_timer.Running = false;
+      }
+      m_cTimerEvents.Clear();
+      fnExpect("timers");
+      c_stream >> unCount;
+      for(UInt32 unIndex = 0; unIndex < unCount; unIndex++) {
+         std::string strId;
+         bool bRunning = false;
+         UInt32 unElapsed = 0;
+         c_stream >> std::quoted(strId) >> bRunning >> unElapsed;
+         std::unordered_map<std::string, UInt32>::iterator itTimerSlot = m_mapTimerSlots.find(strId);
+         if(itTimerSlot == std::end(m_mapTimerSlots)) {
+            LOGERR << "[WARNING] Ignoring unknown timer \"" << strId << "\" in the loop function state" << std::endl;
+            continue;
+         }
+         STimer& sTimer = m_vecTimers[itTimerSlot->second];
+         sTimer.Running = bRunning;
+         sTimer.Start = un_clock - unElapsed;
+         sTimer.Generation++;
+      }
+      /* conditions */
+      fnExpect("conditions");
+      c_stream >> unCount;
+      if(unCount != m_vecConditions.size()) {
+         THROW_ARGOSEXCEPTION("The loop function state has " << unCount << " conditions instead of " <<
+                              m_vecConditions.size());
+      }
+      for(std::unique_ptr<SCondition>& ptr_condition : m_vecConditions) {
+         c_stream >> ptr_condition->Enabled;
+      }
+      /* add entity actions */
+      fnExpect("add_entity_actions");
+      c_stream >> unCount;
+      if(unCount != m_vecAddEntityActions.size()) {
+         THROW_ARGOSEXCEPTION("The loop function state has " << unCount << " add_entity actions instead of " <<
+                              m_vecAddEntityActions.size());
+      }
+      for(SAddEntityAction* ps_action : m_vecAddEntityActions) {
+         c_stream >> ps_action->NextSuffix;
+      }
+      /* pending actions */
+      m_cPendingActions.Clear();
+      fnExpect("pending_actions");
+      c_stream >> unCount;
+      for(UInt32 unIndex = 0; unIndex < unCount; unIndex++) {
+         UInt32 unDelay = 0;
+         UInt32 unAction = 0;
+         c_stream >> unDelay >> unAction;
+         if(unAction >= m_vecActions.size()) {
+            THROW_ARGOSEXCEPTION("Invalid action " << unAction << " in the loop function state");
+         }
+         m_cPendingActions.Schedule(un_clock + unDelay, m_vecActions[unAction]);
+      }
+      /* replace the added entities */
+      for(SAddedEntity& s_added_entity : m_vecAddedEntities) {
+         EraseEntitySnapshot(*s_added_entity.Entity);
+         CallEntityOperation<CSpaceOperationRemoveEntity, CSpace, void>(GetSpace(), *s_added_entity.Entity);
+      }
+      m_vecAddedEntities.clear();
+      fnExpect("added_entities");
+      c_stream >> unCount;
+      for(UInt32 unIndex = 0; unIndex < unCount; unIndex++) {
+         UInt32 unAction = 0;
+         std::string strId;
+         bool bHasBody = false;
+         CVector3 cPosition;
+         CQuaternion cOrientation;
+         c_stream >> unAction >> std::quoted(strId) >> bHasBody;
+         if(bHasBody) {
+            Real pfPose[7];
+            for(Real& f_value : pfPose) {
+               c_stream >> f_value;
+            }
+            cPosition.Set(pfPose[0], pfPose[1], pfPose[2]);
+            cOrientation = CQuaternion(pfPose[3], pfPose[4], pfPose[5], pfPose[6]);
+         }
+         SAddEntityAction* psAction = (unAction < m_vecActions.size()) ?
+            dynamic_cast<SAddEntityAction*>(m_vecActions[unAction]) : nullptr;
+         if(psAction == nullptr) {
+            THROW_ARGOSEXCEPTION("Invalid add_entity action " << unAction << " in the loop function state");
+         }
+         if(GetSpace().GetEntityMapPerId().count(strId) != 0) {
+            LOGERR << "[WARNING] Could not restore entity \""
+                   << strId
+                   << "\" since its id is already in use"
+                   << std::endl;
+            continue;
+         }
+         CEntity* pcEntity = bHasBody ?
+            psAction->Create(strId, &cPosition, &cOrientation) : psAction->Create(strId);
+         CallEntityOperation<CSpaceOperationAddEntity, CSpace, void>(GetSpace(), *pcEntity);
+         m_vecAddedEntities.push_back(SAddedEntity{pcEntity, psAction});
+         InsertEntitySnapshot(*pcEntity);
+      }
+      if(!c_stream) {
+         THROW_ARGOSEXCEPTION("Could not read the loop function state");
+      }
+      /* the inputs of all conditions have changed */
+      if(m_eEvaluation != EEvaluation::POLLING) {
+         for(UInt32 unTimerSlot = 0; unTimerSlot < m_vecTimers.size(); unTimerSlot++) {
+            if(m_vecTimers[unTimerSlot].Running) {
+               ScheduleTimerEvents(unTimerSlot);
+            }
+         }
+      }
+      InvalidateConditions();
+   }
+
    /****************************************/
    /****************************************/
    
    std::unique_ptr<CDISRoCSLoopFunctions::SCondition>
       CDISRoCSLoopFunctions::ParseCondition(TConfigurationNode& t_tree) {
-      std::vector<std::shared_ptr<SAction> > vecActions;
+      std::vector<std::unique_ptr<SAction> > vecActions;
       TConfigurationNodeIterator itAction("action");
       for(itAction = itAction.begin(&t_tree);
           itAction != itAction.end();
@@ -182,24 +641,53 @@ namespace argos {
          }
          GetNodeAttribute(t_tree, "position", cPosition);
          GetNodeAttribute(t_tree, "threshold", fThreshold);
-         return std::make_unique<SEntityCondition>(*this,
-                                                   bOnce,
-                                                   std::move(vecActions),
-                                                   std::move(strId),
-                                                   std::move(strType),
-                                                   cPosition,
-                                                   fThreshold);
+         std::unique_ptr<SEntityCondition> ptrCondition =
+            std::make_unique<SEntityCondition>(*this,
+                                               bOnce,
+                                               std::move(vecActions),
+                                               std::move(strId),
+                                               std::move(strType),
+                                               cPosition,
+                                               fThreshold);
+         if(ptrCondition->EntityType.empty()) {
+            /* entities without a type can be any entity in the space, including entities that
+               are not root entities and that are therefore not tracked by the snapshots */
+            ptrCondition->Volatile = true;
+         }
+         else {
+            m_vecEntityConditions.push_back(ptrCondition.get());
+            m_fMaxEntityConditionThreshold = std::max(m_fMaxEntityConditionThreshold, fThreshold);
+         }
+         return ptrCondition;
+      }
+      else if(strConditionType == "lattice") {
+         CVector3 cPosition;
+         GetNodeAttribute(t_tree, "position", cPosition);
+         std::unique_ptr<SLatticeCondition> ptrCondition =
+            std::make_unique<SLatticeCondition>(*this,
+                                                bOnce,
+                                                std::move(vecActions),
+                                                cPosition);
+         if(NodeAttributeExists(t_tree, "color")) {
+            CColor cColor;
+            GetNodeAttribute(t_tree, "color", cColor);
+            ptrCondition->Color = cColor;
+         }
+         return ptrCondition;
       }
       else if(strConditionType == "timer") {
          std::string strId;
          UInt32 unValue;
          GetNodeAttribute(t_tree, "id", strId);
          GetNodeAttribute(t_tree, "value", unValue);
-         return std::make_unique<STimerCondition>(*this,
-                                                  bOnce,
-                                                  std::move(vecActions),
-                                                  std::move(strId),
-                                                  unValue);
+         std::unique_ptr<STimerCondition> ptrCondition =
+            std::make_unique<STimerCondition>(*this,
+                                              bOnce,
+                                              std::move(vecActions),
+                                              std::move(strId),
+                                              unValue);
+         m_vecTimerConditions[ptrCondition->TimerSlot].push_back(ptrCondition.get());
+         return ptrCondition;
       }
       else {
          THROW_ARGOSEXCEPTION("Loop function condition type \"" << strConditionType << "\" not implemented.");
@@ -209,8 +697,23 @@ namespace argos {
    /****************************************/
    /****************************************/
 
-   std::shared_ptr<CDISRoCSLoopFunctions::SAction> 
+   std::unique_ptr<CDISRoCSLoopFunctions::SAction>
       CDISRoCSLoopFunctions::ParseAction(TConfigurationNode& t_tree) {
+      std::unique_ptr<SAction> ptrAction = ParseActionType(t_tree);
+      m_vecActions.push_back(ptrAction.get());
+#ifdef DI_SROCS_PROFILING
+      std::string strActionType;
+      GetNodeAttribute(t_tree, "type", strActionType);
+      ptrAction->ProfileStatistic = m_cProfiler.Register("action:" + strActionType);
+#endif
+      return ptrAction;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   std::unique_ptr<CDISRoCSLoopFunctions::SAction>
+      CDISRoCSLoopFunctions::ParseActionType(TConfigurationNode& t_tree) {
       std::string strActionType;
       UInt32 unDelay = 0;
       GetNodeAttribute(t_tree, "type", strActionType);
@@ -218,7 +721,7 @@ namespace argos {
       if(strActionType == "add_timer") {
          std::string strId;
          GetNodeAttribute(t_tree, "id", strId);
-         return std::make_shared<SAddTimerAction>(*this, unDelay, std::move(strId));
+         return std::make_unique<SAddTimerAction>(*this, unDelay, std::move(strId));
       }
       else if(strActionType == "add_entity") {
          TConfigurationNodeIterator itEntity;
@@ -226,7 +729,20 @@ namespace argos {
          if(itEntity == itEntity.end()) {
             THROW_ARGOSEXCEPTION("No entity provided in an add_entity action");
          }
-         return std::make_shared<SAddEntityAction>(*this, unDelay, *itEntity);
+         std::unique_ptr<SAddEntityAction> ptrAction =
+            std::make_unique<SAddEntityAction>(*this, unDelay, *itEntity);
+         m_vecAddEntityActions.push_back(ptrAction.get());
+         GetNodeAttributeOrDefault(t_tree, "search_radius", ptrAction->SearchRadius, ptrAction->SearchRadius);
+         GetNodeAttributeOrDefault(t_tree, "search_step", ptrAction->SearchStep, ptrAction->SearchStep);
+         if(ptrAction->SearchStep <= 0.0) {
+            THROW_ARGOSEXCEPTION("The search step of an add_entity action must be greater than zero");
+         }
+         if(NodeExists(ptrAction->Configuration, "body")) {
+            CVector3 cBodyPosition;
+            GetNodeAttribute(GetNode(ptrAction->Configuration, "body"), "position", cBodyPosition);
+            ptrAction->BodyPosition.emplace(cBodyPosition);
+         }
+         return ptrAction;
       }
       else if(strActionType == "remove_entity") {
          std::string strTarget;
@@ -249,14 +765,14 @@ namespace argos {
             GetNodeAttribute(t_tree, "threshold", fThreshold);
             optPosition.emplace(std::make_pair(cPosition, fThreshold));
          }
-         return std::make_shared<SRemoveEntityAction>(*this,
+         return std::make_unique<SRemoveEntityAction>(*this,
                                                       unDelay,
                                                       std::move(strId),
                                                       std::move(strType),
                                                       optPosition);
       }
       else if(strActionType == "terminate") {
-         return std::make_shared<STerminateAction>(*this, unDelay);
+         return std::make_unique<STerminateAction>(*this, unDelay);
       }
       else {
          THROW_ARGOSEXCEPTION("Loop function action type \"" << strActionType << "\" not implemented.");
@@ -266,37 +782,622 @@ namespace argos {
    /****************************************/
    /****************************************/
 
-   void CDISRoCSLoopFunctions::LogEntityToFile(const std::string& str_entity_id,
-                                               const CEmbodiedEntity& c_embodied_entity,
-                                               const CDebugEntity& c_debug_entity) {
-      UInt32 unClock = GetSpace().GetSimulationClock();
-      std::map<std::string, std::ofstream>::iterator itOutputStream =
-         m_mapOutputStreams.find(str_entity_id);
-      if(itOutputStream == std::end(m_mapOutputStreams)) {
-         std::pair<std::map<std::string, std::ofstream>::iterator, bool> cResult =
-            m_mapOutputStreams.emplace(std::piecewise_construct,
-                                       std::forward_as_tuple(str_entity_id),
-                                       std::forward_as_tuple(str_entity_id + ".csv",
-                                                             std::ios_base::out |
-                                                             std::ios_base::trunc));
-         if(cResult.second) {
-            itOutputStream = cResult.first;
+   bool CDISRoCSLoopFunctions::CompareEntitySnapshots(const SEntitySnapshot& s_lhs,
+                                                      const SEntitySnapshot& s_rhs) {
+      if(s_lhs.TypeId != s_rhs.TypeId) {
+         return s_lhs.TypeId < s_rhs.TypeId;
+      }
+      return s_lhs.Entity->GetId() < s_rhs.Entity->GetId();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CDISRoCSLoopFunctions::GetEntityTypeId(const std::string& str_entity_type) {
+      return m_mapEntityTypeIds.emplace(str_entity_type, m_mapEntityTypeIds.size()).first->second;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CDISRoCSLoopFunctions::GetTimerSlot(const std::string& str_timer_id) {
+      std::pair<std::unordered_map<std::string, UInt32>::iterator, bool> cInsert =
+         m_mapTimerSlots.emplace(str_timer_id, m_vecTimers.size());
+      if(cInsert.second) {
+         m_vecTimers.emplace_back();
+         m_vecTimerConditions.emplace_back();
+      }
+      return cInsert.first->second;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::UpdateEntitySnapshots() {
+      /* entities can also be added or removed outside of the loop functions, e.g., by the GUI */
+      if(m_vecRootEntities != GetSpace().GetRootEntityVector()) {
+         RebuildEntitySnapshots();
+         return;
+      }
+      for(UInt32 unIndex = 0; unIndex < m_vecEntitySnapshots.size(); unIndex++) {
+         SEntitySnapshot& sSnapshot = m_vecEntitySnapshots[unIndex];
+         if(sSnapshot.EmbodiedEntity != nullptr) {
+            const SAnchor& sOriginAnchor = sSnapshot.EmbodiedEntity->GetOriginAnchor();
+            if(m_eEvaluation != EEvaluation::POLLING && sSnapshot.Position != sOriginAnchor.Position) {
+               NotifyEntityChanged(sSnapshot, &sSnapshot.Position, &sOriginAnchor.Position);
+            }
+            sSnapshot.Position = sOriginAnchor.Position;
+            sSnapshot.Orientation = sOriginAnchor.Orientation;
+            m_cSpatialIndex.Update(unIndex, sSnapshot.Position);
+            if(sSnapshot.TypeId == BLOCK_TYPE_ID) {
+               m_cLatticeIndex.Update(unIndex, sSnapshot.Position);
+            }
          }
-         else {
-            THROW_ARGOSEXCEPTION("Could not insert output stream into map");
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::RebuildEntitySnapshots() {
+      m_vecEntitySnapshots.clear();
+      m_vecFreeEntitySnapshots.clear();
+      m_mapEntitySnapshots.clear();
+      m_vecSortedEntitySnapshots.clear();
+      m_vecRootEntities = GetSpace().GetRootEntityVector();
+      for(CEntity* pc_entity : m_vecRootEntities) {
+         m_mapEntitySnapshots[pc_entity->GetId()] = m_vecEntitySnapshots.size();
+         m_vecSortedEntitySnapshots.push_back(m_vecEntitySnapshots.size());
+         m_vecEntitySnapshots.push_back(MakeEntitySnapshot(*pc_entity));
+      }
+      std::sort(std::begin(m_vecSortedEntitySnapshots),
+                std::end(m_vecSortedEntitySnapshots),
+                [this] (UInt32 un_lhs, UInt32 un_rhs) {
+         return CompareEntitySnapshots(m_vecEntitySnapshots[un_lhs], m_vecEntitySnapshots[un_rhs]);
+      });
+      RebuildSpatialIndex();
+      /* entities could have been added or removed anywhere */
+      InvalidateConditions();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::UpdateMetrics(UInt32 un_clock) {
+      /* number the blocks from zero */
+      m_vecBlockNumbers.resize(m_vecEntitySnapshots.size());
+      UInt32 unBlocks = 0;
+      for(UInt32 unIndex = 0; unIndex < m_vecEntitySnapshots.size(); unIndex++) {
+         if(m_vecEntitySnapshots[unIndex].TypeId == BLOCK_TYPE_ID) {
+            m_vecBlockNumbers[unIndex] = unBlocks++;
+         }
+      }
+      m_cMetrics.BeginSample(unBlocks);
+      /* join each block on the lattice with the blocks at the next lattice points along the
+         axes, which visits every pair of neighbours once */
+      static const CVector3 pcNeighbourOffsets[] = {
+         CVector3::X * CDISRoCSMetrics::BLOCK_SIDE_LENGTH,
+         CVector3::Y * CDISRoCSMetrics::BLOCK_SIDE_LENGTH,
+         CVector3::Z * CDISRoCSMetrics::BLOCK_SIDE_LENGTH,
+      };
+      for(UInt32 unIndex = 0; unIndex < m_vecEntitySnapshots.size(); unIndex++) {
+         const SEntitySnapshot& sBlock = m_vecEntitySnapshots[unIndex];
+         if(sBlock.TypeId != BLOCK_TYPE_ID || sBlock.EmbodiedEntity == nullptr) {
+            continue;
+         }
+         /* blocks that are not on the lattice, e.g., carried blocks, are not part of a structure */
+         CVector3 cLatticePoint = SnapToLattice(sBlock.Position);
+         if(Distance(sBlock.Position, cLatticePoint) >= m_fLatticeTolerance) {
+            continue;
+         }
+         for(const CVector3& c_offset : pcNeighbourOffsets) {
+            ForEachBlockAtLatticePoint(cLatticePoint + c_offset, [&] (UInt32 un_index) {
+               m_cMetrics.JoinBlocks(m_vecBlockNumbers[unIndex], m_vecBlockNumbers[un_index]);
+               return false;
+            });
+         }
+      }
+      /* a robot is idle if it has neither moved nor turned since the previous sample */
+      for(SEntitySnapshot& s_snapshot : m_vecEntitySnapshots) {
+         if(s_snapshot.TypeId != BUILDERBOT_TYPE_ID || s_snapshot.EmbodiedEntity == nullptr) {
+            continue;
+         }
+         const CQuaternion& cOrientation = s_snapshot.Orientation;
+         const CQuaternion& cPreviousOrientation = s_snapshot.PreviousOrientation;
+         Real fDotProduct = std::abs(cOrientation.GetW() * cPreviousOrientation.GetW() +
+                                     cOrientation.GetX() * cPreviousOrientation.GetX() +
+                                     cOrientation.GetY() * cPreviousOrientation.GetY() +
+                                     cOrientation.GetZ() * cPreviousOrientation.GetZ());
+         Real fAngle = 2.0 * std::acos(std::min<Real>(fDotProduct, 1.0));
+         Real fDistance = Distance(s_snapshot.Position, s_snapshot.PreviousPosition);
+         m_cMetrics.AddRobot(fDistance < m_cMetrics.GetIdleDistance() &&
+                             fAngle < m_cMetrics.GetIdleAngle());
+         s_snapshot.PreviousPosition = s_snapshot.Position;
+         s_snapshot.PreviousOrientation = s_snapshot.Orientation;
+      }
+      m_cMetrics.EndSample(un_clock);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CDISRoCSLoopFunctions::SEntitySnapshot
+      CDISRoCSLoopFunctions::MakeEntitySnapshot(CEntity& c_entity) {
+      SEntitySnapshot sSnapshot;
+      sSnapshot.Entity = &c_entity;
+      sSnapshot.EmbodiedEntity = nullptr;
+      sSnapshot.DebugEntity = nullptr;
+      sSnapshot.TypeId = GetEntityTypeId(c_entity.GetTypeDescription());
+      sSnapshot.IdHash = std::hash<std::string>()(c_entity.GetId());
+      CComposableEntity* pcComposableEntity =
+         dynamic_cast<CComposableEntity*>(&c_entity);
+      if(pcComposableEntity != nullptr) {
+         if(pcComposableEntity->HasComponent("body")) {
+            sSnapshot.EmbodiedEntity =
+               &pcComposableEntity->GetComponent<CEmbodiedEntity>("body");
+            const SAnchor& sOriginAnchor = sSnapshot.EmbodiedEntity->GetOriginAnchor();
+            sSnapshot.Position = sOriginAnchor.Position;
+            sSnapshot.Orientation = sOriginAnchor.Orientation;
+            sSnapshot.PreviousPosition = sSnapshot.Position;
+            sSnapshot.PreviousOrientation = sSnapshot.Orientation;
+            /* learn the extents of the entity type from the first entity with a valid box */
+            SEntityExtents& sExtents = GetEntityExtents(sSnapshot.TypeId);
+            const SBoundingBox& sBoundingBox = sSnapshot.EmbodiedEntity->GetBoundingBox();
+            if(!sExtents.Known &&
+               sBoundingBox.MinCorner.GetX() < sBoundingBox.MaxCorner.GetX() &&
+               sBoundingBox.MinCorner.GetY() < sBoundingBox.MaxCorner.GetY() &&
+               sBoundingBox.MinCorner.GetZ() < sBoundingBox.MaxCorner.GetZ()) {
+               sExtents.Known = true;
+               sExtents.MinCorner = sBoundingBox.MinCorner - sSnapshot.Position;
+               sExtents.MaxCorner = sBoundingBox.MaxCorner - sSnapshot.Position;
+               m_fMaxEntityExtent = std::max(m_fMaxEntityExtent,
+                                             std::max(sExtents.MinCorner.Length(),
+                                                      sExtents.MaxCorner.Length()));
+            }
+         }
+         if(CBuilderBotEntity* pcBuilderBot = dynamic_cast<CBuilderBotEntity*>(&c_entity)) {
+            sSnapshot.DebugEntity = &pcBuilderBot->GetDebugEntity();
+         }
+         else if(CBlockEntity* pcBlock = dynamic_cast<CBlockEntity*>(&c_entity)) {
+            sSnapshot.DebugEntity = &pcBlock->GetDebugEntity();
+         }
+      }
+      return sSnapshot;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::InsertEntitySnapshot(CEntity& c_entity) {
+      /* reuse a free snapshot, so that the indices of the other snapshots do not change */
+      UInt32 unIndex = m_vecEntitySnapshots.size();
+      if(m_vecFreeEntitySnapshots.empty()) {
+         m_vecEntitySnapshots.push_back(MakeEntitySnapshot(c_entity));
+      }
+      else {
+         unIndex = m_vecFreeEntitySnapshots.back();
+         m_vecFreeEntitySnapshots.pop_back();
+         m_vecEntitySnapshots[unIndex] = MakeEntitySnapshot(c_entity);
+      }
+      m_mapEntitySnapshots[c_entity.GetId()] = unIndex;
+      m_vecRootEntities.push_back(&c_entity);
+      /* keep the sorted snapshots sorted by type and id */
+      std::vector<UInt32>::iterator itSorted =
+         std::lower_bound(std::begin(m_vecSortedEntitySnapshots),
+                          std::end(m_vecSortedEntitySnapshots),
+                          unIndex,
+                          [this] (UInt32 un_lhs, UInt32 un_rhs) {
+            return CompareEntitySnapshots(m_vecEntitySnapshots[un_lhs], m_vecEntitySnapshots[un_rhs]);
+         });
+      m_vecSortedEntitySnapshots.insert(itSorted, unIndex);
+      m_cSpatialIndex.Reserve(m_vecEntitySnapshots.size());
+      m_cLatticeIndex.Reserve(m_vecEntitySnapshots.size());
+      const SEntitySnapshot& sSnapshot = m_vecEntitySnapshots[unIndex];
+      if(sSnapshot.EmbodiedEntity != nullptr) {
+         m_cSpatialIndex.Insert(unIndex, sSnapshot.Position);
+         if(sSnapshot.TypeId == BLOCK_TYPE_ID) {
+            m_cLatticeIndex.Insert(unIndex, sSnapshot.Position);
          }
+         NotifyEntityChanged(sSnapshot, nullptr, &sSnapshot.Position);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::EraseEntitySnapshot(CEntity& c_entity) {
+      std::unordered_map<std::string, UInt32>::iterator itSnapshot =
+         m_mapEntitySnapshots.find(c_entity.GetId());
+      if(itSnapshot == std::end(m_mapEntitySnapshots) ||
+         m_vecEntitySnapshots[itSnapshot->second].Entity != &c_entity) {
+         return;
+      }
+      UInt32 unIndex = itSnapshot->second;
+      SEntitySnapshot& sSnapshot = m_vecEntitySnapshots[unIndex];
+      if(sSnapshot.EmbodiedEntity != nullptr) {
+         NotifyEntityChanged(sSnapshot, &sSnapshot.Position, nullptr);
+         m_cSpatialIndex.Remove(unIndex);
+         m_cLatticeIndex.Remove(unIndex);
+      }
+      /* the ids are unique, so the lower bound is the snapshot itself */
+      std::vector<UInt32>::iterator itSorted =
+         std::lower_bound(std::begin(m_vecSortedEntitySnapshots),
+                          std::end(m_vecSortedEntitySnapshots),
+                          unIndex,
+                          [this] (UInt32 un_lhs, UInt32 un_rhs) {
+            return CompareEntitySnapshots(m_vecEntitySnapshots[un_lhs], m_vecEntitySnapshots[un_rhs]);
+         });
+      m_vecSortedEntitySnapshots.erase(itSorted);
+      std::vector<CEntity*>::iterator itRootEntity =
+         std::find(std::begin(m_vecRootEntities), std::end(m_vecRootEntities), &c_entity);
+      if(itRootEntity != std::end(m_vecRootEntities)) {
+         m_vecRootEntities.erase(itRootEntity);
+      }
+      m_mapEntitySnapshots.erase(itSnapshot);
+      /* free the snapshot */
+      sSnapshot.Entity = nullptr;
+      sSnapshot.EmbodiedEntity = nullptr;
+      sSnapshot.DebugEntity = nullptr;
+      sSnapshot.TypeId = FREE_TYPE_ID;
+      sSnapshot.IdHash = 0;
+      m_vecFreeEntitySnapshots.push_back(unIndex);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   SInt32 CDISRoCSLoopFunctions::FindEntitySnapshot(const std::string& str_entity_id) const {
+      std::unordered_map<std::string, UInt32>::const_iterator itSnapshot =
+         m_mapEntitySnapshots.find(str_entity_id);
+      return (itSnapshot == std::end(m_mapEntitySnapshots)) ?
+         -1 : static_cast<SInt32>(itSnapshot->second);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::RemoveEntity(CEntity& c_entity) {
+      EraseEntitySnapshot(c_entity);
+      /* forget the entity if it was added by the loop functions */
+      std::vector<SAddedEntity>::iterator itAddedEntity =
+         std::find_if(std::begin(m_vecAddedEntities),
+                   std::end(m_vecAddedEntities),
+                   [&c_entity] (const SAddedEntity& s_added_entity) {
+            return s_added_entity.Entity == &c_entity;
+         });
+      if(itAddedEntity != std::end(m_vecAddedEntities)) {
+         m_vecAddedEntities.erase(itAddedEntity);
+      }
+      CallEntityOperation<CSpaceOperationRemoveEntity, CSpace, void>(GetSpace(), c_entity);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CDISRoCSLoopFunctions::SEntityExtents&
+      CDISRoCSLoopFunctions::GetEntityExtents(UInt32 un_entity_type_id) {
+      if(un_entity_type_id >= m_vecEntityTypeExtents.size()) {
+         m_vecEntityTypeExtents.resize(un_entity_type_id + 1);
+      }
+      return m_vecEntityTypeExtents[un_entity_type_id];
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CDISRoCSLoopFunctions::IsVolumeFree(const CVector3& c_min_corner,
+                                            const CVector3& c_max_corner) const {
+      /* entities that are resting on each other have touching bounding boxes */
+      const Real fTolerance = 1e-4;
+      CVector3 cCenter = (c_min_corner + c_max_corner) * 0.5;
+      Real fRadius = Distance(cCenter, c_max_corner) + m_fMaxEntityExtent;
+      return !m_cSpatialIndex.ForEachInSphere(cCenter, fRadius, [&] (UInt32 un_index) {
+         const SBoundingBox& sBoundingBox =
+            m_vecEntitySnapshots[un_index].EmbodiedEntity->GetBoundingBox();
+         return (sBoundingBox.MinCorner.GetX() < c_max_corner.GetX() - fTolerance) &&
+                (sBoundingBox.MaxCorner.GetX() > c_min_corner.GetX() + fTolerance) &&
+                (sBoundingBox.MinCorner.GetY() < c_max_corner.GetY() - fTolerance) &&
+                (sBoundingBox.MaxCorner.GetY() > c_min_corner.GetY() + fTolerance) &&
+                (sBoundingBox.MinCorner.GetZ() < c_max_corner.GetZ() - fTolerance) &&
+                (sBoundingBox.MaxCorner.GetZ() > c_min_corner.GetZ() + fTolerance);
+      });
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CDISRoCSLoopFunctions::FindFreePosition(const SEntityExtents& s_extents,
+                                                const CVector3& c_position,
+                                                Real f_search_radius,
+                                                Real f_search_step,
+                                                CVector3& c_free_position) const {
+      if(IsVolumeFree(c_position + s_extents.MinCorner, c_position + s_extents.MaxCorner)) {
+         c_free_position = c_position;
+         return true;
+      }
+      /* try rings of increasing radius, so that the first free position is (approximately)
+         the nearest one */
+      for(UInt32 unRing = 1; unRing * f_search_step <= f_search_radius; unRing++) {
+         Real fRadius = unRing * f_search_step;
+         UInt32 unSamples = 6 * unRing;
+         for(UInt32 unSample = 0; unSample < unSamples; unSample++) {
+            CRadians cAngle = CRadians::TWO_PI * (static_cast<Real>(unSample) / unSamples);
+            CVector3 cCandidate = c_position +
+               CVector3(fRadius * Cos(cAngle), fRadius * Sin(cAngle), 0.0);
+            if(IsVolumeFree(cCandidate + s_extents.MinCorner, cCandidate + s_extents.MaxCorner)) {
+               c_free_position = cCandidate;
+               return true;
+            }
+         }
+      }
+      return false;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::ScheduleTimerEvents(UInt32 un_timer_slot) {
+      const STimer& sTimer = m_vecTimers[un_timer_slot];
+      /* a condition on the timer can only change when the timer reaches its value and on
+         the following step */
+      for(STimerCondition* ps_condition : m_vecTimerConditions[un_timer_slot]) {
+         ps_condition->Invalidate();
+         m_cTimerEvents.Schedule(sTimer.Start + ps_condition->Value,
+                                 STimerEvent{ps_condition, sTimer.Generation});
+         m_cTimerEvents.Schedule(sTimer.Start + ps_condition->Value + 1,
+                                 STimerEvent{ps_condition, sTimer.Generation});
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::RebuildSpatialIndex() {
+      m_cSpatialIndex.Clear(m_vecEntitySnapshots.size());
+      m_cLatticeIndex.Clear(m_vecEntitySnapshots.size());
+      for(UInt32 unIndex = 0; unIndex < m_vecEntitySnapshots.size(); unIndex++) {
+         const SEntitySnapshot& sSnapshot = m_vecEntitySnapshots[unIndex];
+         if(sSnapshot.EmbodiedEntity != nullptr) {
+            m_cSpatialIndex.Insert(unIndex, sSnapshot.Position);
+            if(sSnapshot.TypeId == BLOCK_TYPE_ID) {
+               m_cLatticeIndex.Insert(unIndex, sSnapshot.Position);
+            }
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CVector3 CDISRoCSLoopFunctions::SnapToLattice(const CVector3& c_position) const {
+      CVector3 cOffset = (c_position - m_cLatticeOrigin) / CDISRoCSMetrics::BLOCK_SIDE_LENGTH;
+      return m_cLatticeOrigin + CVector3(std::round(cOffset.GetX()),
+                                         std::round(cOffset.GetY()),
+                                         std::round(cOffset.GetZ())) * CDISRoCSMetrics::BLOCK_SIDE_LENGTH;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::CompileCondition(SCondition& s_condition) {
+      if(SEntityCondition* psCondition = dynamic_cast<SEntityCondition*>(&s_condition)) {
+         m_vecProgram.push_back(SInstruction{SInstruction::EOpcode::ENTITY, 0, psCondition});
+      }
+      else if(STimerCondition* psCondition = dynamic_cast<STimerCondition*>(&s_condition)) {
+         m_vecProgram.push_back(SInstruction{SInstruction::EOpcode::TIMER, 0, psCondition});
+      }
+      else if(SLatticeCondition* psCondition = dynamic_cast<SLatticeCondition*>(&s_condition)) {
+         m_vecProgram.push_back(SInstruction{SInstruction::EOpcode::LATTICE, 0, psCondition});
+      }
+      else if(SNotCondition* psCondition = dynamic_cast<SNotCondition*>(&s_condition)) {
+         CompileCondition(*psCondition->Condition);
+         m_vecProgram.push_back(SInstruction{SInstruction::EOpcode::NOT, 0, nullptr});
+      }
+      else if(dynamic_cast<SAllCondition*>(&s_condition) != nullptr ||
+              dynamic_cast<SAnyCondition*>(&s_condition) != nullptr) {
+         bool bAll = (dynamic_cast<SAllCondition*>(&s_condition) != nullptr);
+         std::vector<std::unique_ptr<SCondition> >& vecConditions = bAll ?
+            static_cast<SAllCondition&>(s_condition).Conditions :
+            static_cast<SAnyCondition&>(s_condition).Conditions;
+         if(vecConditions.empty()) {
+            /* an empty all condition is true and an empty any condition is false */
+            m_vecProgram.push_back(SInstruction{SInstruction::EOpcode::CONSTANT, bAll, nullptr});
+            return;
+         }
+         /* jump to the end as soon as the result is known */
+         std::vector<UInt32> vecJumps;
+         for(UInt32 unIndex = 0; unIndex < vecConditions.size(); unIndex++) {
+            CompileCondition(*vecConditions[unIndex]);
+            if(unIndex + 1 < vecConditions.size()) {
+               vecJumps.push_back(m_vecProgram.size());
+               m_vecProgram.push_back(SInstruction{bAll ?
+                                                   SInstruction::EOpcode::JUMP_IF_FALSE :
+                                                   SInstruction::EOpcode::JUMP_IF_TRUE, 0, nullptr});
+            }
+         }
+         for(UInt32 unJump : vecJumps) {
+            m_vecProgram[unJump].Operand = m_vecProgram.size();
+         }
+      }
+      else {
+         m_vecProgram.push_back(SInstruction{SInstruction::EOpcode::CONDITION, 0, &s_condition});
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   template<class TCondition>
+   bool CDISRoCSLoopFunctions::EvaluateLeaf(TCondition& s_condition) {
+      if(m_eEvaluation == EEvaluation::POLLING || m_bForcePolling) {
+         return s_condition.TCondition::IsTrue();
+      }
+      if(s_condition.Dirty || s_condition.Volatile) {
+         s_condition.Value = s_condition.TCondition::IsTrue();
+         s_condition.Dirty = false;
+      }
+      return s_condition.Value;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CDISRoCSLoopFunctions::ExecuteProgram(UInt32 un_entry) {
+      bool bResult = false;
+      for(UInt32 unInstruction = un_entry;; unInstruction++) {
+         const SInstruction& sInstruction = m_vecProgram[unInstruction];
+         switch(sInstruction.Opcode) {
+            case SInstruction::EOpcode::ENTITY: {
+               DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileEntityConditions);
+               bResult = EvaluateLeaf(*static_cast<SEntityCondition*>(sInstruction.Condition));
+               break;
+            }
+            case SInstruction::EOpcode::TIMER: {
+               DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileTimerConditions);
+               bResult = EvaluateLeaf(*static_cast<STimerCondition*>(sInstruction.Condition));
+               break;
+            }
+            case SInstruction::EOpcode::LATTICE: {
+               DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileLatticeConditions);
+               bResult = EvaluateLeaf(*static_cast<SLatticeCondition*>(sInstruction.Condition));
+               break;
+            }
+            case SInstruction::EOpcode::CONDITION: {
+               DI_SROCS_PROFILE_SCOPE(m_cProfiler, m_unProfileOtherConditions);
+               bResult = sInstruction.Condition->Evaluate();
+               break;
+            }
+            case SInstruction::EOpcode::CONSTANT:
+               bResult = (sInstruction.Operand != 0);
+               break;
+            case SInstruction::EOpcode::NOT:
+               bResult = !bResult;
+               break;
+            case SInstruction::EOpcode::JUMP_IF_TRUE:
+               if(bResult) {
+                  /* the loop increments the instruction counter */
+                  unInstruction = sInstruction.Operand - 1;
+               }
+               break;
+            case SInstruction::EOpcode::JUMP_IF_FALSE:
+               if(!bResult) {
+                  unInstruction = sInstruction.Operand - 1;
+               }
+               break;
+            case SInstruction::EOpcode::RETURN:
+               return bResult;
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CDISRoCSLoopFunctions::EvaluateCondition(UInt32 un_condition) {
+      SCondition& sCondition = *m_vecConditions[un_condition];
+      UInt32 unEntry = m_vecProgramEntries[un_condition];
+      if(m_eEvaluation == EEvaluation::POLLING) {
+         return ExecuteProgram(unEntry);
+      }
+      /* the leaves and the top-level conditions cache their results, the composite conditions
+         in between are cheap to recompute from the leaves */
+      if(sCondition.Dirty || sCondition.Volatile) {
+         sCondition.Value = ExecuteProgram(unEntry);
+         sCondition.Dirty = false;
+      }
+      bool bEventValue = sCondition.Value;
+      if(m_eEvaluation == EEvaluation::EVENT) {
+         return bEventValue;
+      }
+      m_bForcePolling = true;
+      bool bPollingValue = ExecuteProgram(unEntry);
+      m_bForcePolling = false;
+      if(bEventValue != bPollingValue) {
+         THROW_ARGOSEXCEPTION("Event-driven evaluation of a condition returned " <<
+                              (bEventValue ? "true" : "false") << " instead of " <<
+                              (bPollingValue ? "true" : "false") << " at step " <<
+                              GetSpace().GetSimulationClock());
+      }
+      return bPollingValue;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::NotifyEntityChanged(const SEntitySnapshot& s_snapshot,
+                                                   const CVector3* pc_old_position,
+                                                   const CVector3* pc_new_position) {
+      if(m_eEvaluation == EEvaluation::POLLING) {
+         return;
+      }
+      /* a condition only needs to be re-evaluated if the entity entered or left its sphere */
+      auto fnVisitor = [&] (UInt32 un_index) {
+         SEntityCondition& sCondition = *m_vecEntityConditions[un_index];
+         if(sCondition.EntityTypeId != s_snapshot.TypeId) {
+            return false;
+         }
+         if(!sCondition.EntityId.empty() &&
+            (sCondition.EntityIdHash != s_snapshot.IdHash ||
+             sCondition.EntityId != s_snapshot.Entity->GetId())) {
+            return false;
+         }
+         bool bWasInside = (pc_old_position != nullptr) &&
+            (Distance(sCondition.Position, *pc_old_position) < sCondition.Threshold);
+         bool bIsInside = (pc_new_position != nullptr) &&
+            (Distance(sCondition.Position, *pc_new_position) < sCondition.Threshold);
+         if(bWasInside != bIsInside) {
+            sCondition.Invalidate();
+         }
+         return false;
+      };
+      if(pc_old_position != nullptr) {
+         m_cEntityConditionIndex.ForEachInSphere(*pc_old_position, m_fMaxEntityConditionThreshold, fnVisitor);
+      }
+      if(pc_new_position != nullptr) {
+         m_cEntityConditionIndex.ForEachInSphere(*pc_new_position, m_fMaxEntityConditionThreshold, fnVisitor);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::InvalidateConditions() {
+      for(SEntityCondition* ps_condition : m_vecEntityConditions) {
+         ps_condition->Invalidate();
+      }
+      for(std::vector<STimerCondition*>& vec_timer_conditions : m_vecTimerConditions) {
+         for(STimerCondition* ps_condition : vec_timer_conditions) {
+            ps_condition->Invalidate();
+         }
+      }
+      for(std::unique_ptr<SCondition>& ptr_condition : m_vecConditions) {
+         ptr_condition->Invalidate();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CDISRoCSLoopFunctions::SCondition::Evaluate() {
+      if(Parent.m_eEvaluation == EEvaluation::POLLING || Parent.m_bForcePolling) {
+         return IsTrue();
+      }
+      if(Dirty || Volatile) {
+         Value = IsTrue();
+         Dirty = false;
+      }
+      return Value;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::SCondition::Invalidate() {
+      /* always walk up to the root, a clean parent can have a dirty child that was skipped by
+         short-circuit evaluation */
+      for(SCondition* psCondition = this; psCondition != nullptr; psCondition = psCondition->Owner) {
+         psCondition->Dirty = true;
       }
-      std::string strOutputBuffer(c_debug_entity.GetBuffer("loop_functions"));
-      std::string::iterator itRemove =
-         std::remove(std::begin(strOutputBuffer), std::end(strOutputBuffer), '\n');
-      strOutputBuffer.erase(itRemove, std::end(strOutputBuffer));
-      itOutputStream->second 
-         << unClock
-         << ","
-         << c_embodied_entity.GetOriginAnchor().Position
-         << ","
-         << strOutputBuffer
-         << std::endl;
    }
 
    /****************************************/
@@ -304,7 +1405,7 @@ namespace argos {
 
    bool CDISRoCSLoopFunctions::SAnyCondition::IsTrue() {
       for(std::unique_ptr<SCondition>& ptr_condition : Conditions) {
-         if(ptr_condition->IsTrue()) {
+         if(ptr_condition->Evaluate()) {
             return true;
          }
       }
@@ -316,7 +1417,7 @@ namespace argos {
 
    bool CDISRoCSLoopFunctions::SAllCondition::IsTrue() {
       for(std::unique_ptr<SCondition>& ptr_condition : Conditions) {
-         if(!ptr_condition->IsTrue()) {
+         if(!ptr_condition->Evaluate()) {
             return false;
          }
       }
@@ -327,89 +1428,111 @@ namespace argos {
    /****************************************/
 
    bool CDISRoCSLoopFunctions::SNotCondition::IsTrue() {
-      return !(Condition->IsTrue());
+      return !(Condition->Evaluate());
    }
 
    /****************************************/
    /****************************************/
 
    bool CDISRoCSLoopFunctions::SEntityCondition::IsTrue() {
-      try {
-         std::vector<CEntity*> vecCandidateEntities;
-         if(!EntityType.empty()) {
-            for(CEntity* pc_entity : Parent.GetSpace().GetRootEntityVector()) {
-               if(pc_entity->GetTypeDescription() == EntityType) {
-                  if(!EntityId.empty() && (pc_entity->GetId() != EntityId)) {
-                     continue;
-                  }
-                  vecCandidateEntities.push_back(pc_entity);
-               }
+      if(EntityType.empty()) {
+         SInt32 nIndex = Parent.FindEntitySnapshot(EntityId);
+         if(nIndex < 0) {
+            /* not a root entity, fall back to looking it up in the space */
+            CEntity::TMap& mapEntities = Parent.GetSpace().GetEntityMapPerId();
+            CEntity::TMap::iterator itEntity = mapEntities.find(EntityId);
+            if(itEntity == std::end(mapEntities)) {
+               return false;
             }
-         }
-         else {
-            vecCandidateEntities.push_back(&Parent.GetSpace().GetEntity(EntityId));
-         }
-         for(CEntity* pc_entity : vecCandidateEntities) {
             CComposableEntity* pcComposableEntity =
-               dynamic_cast<CComposableEntity*>(pc_entity);
+               dynamic_cast<CComposableEntity*>(itEntity->second);
             if(pcComposableEntity != nullptr && pcComposableEntity->HasComponent("body")) {
                CEmbodiedEntity& cEmbodiedEntity =
                   pcComposableEntity->GetComponent<CEmbodiedEntity>("body");
-               Real fDistance =
-                  Distance(Position, cEmbodiedEntity.GetOriginAnchor().Position);
-               if(fDistance < Threshold) {
-                  return true;
-               }
+               return Distance(Position, cEmbodiedEntity.GetOriginAnchor().Position) < Threshold;
             }
+            return false;
          }
+         const SEntitySnapshot& sSnapshot = Parent.m_vecEntitySnapshots[nIndex];
+         return (sSnapshot.EmbodiedEntity != nullptr) &&
+            (Distance(Position, sSnapshot.Position) < Threshold);
       }
-      catch(CARGoSException& ex) {}
-      /* if we reach this point the condition is false */
-      return false;
+      /* only visit the entities in the cells of the spatial index that overlap the threshold */
+      return Parent.m_cSpatialIndex.ForEachInSphere(Position, Threshold, [this] (UInt32 un_index) {
+         const SEntitySnapshot& sSnapshot = Parent.m_vecEntitySnapshots[un_index];
+         if(sSnapshot.TypeId != EntityTypeId) {
+            return false;
+         }
+         if(!EntityId.empty() &&
+            (sSnapshot.IdHash != EntityIdHash || sSnapshot.Entity->GetId() != EntityId)) {
+            return false;
+         }
+         return Distance(Position, sSnapshot.Position) < Threshold;
+      });
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CDISRoCSLoopFunctions::SLatticeCondition::IsTrue() {
+      return Parent.ForEachBlockAtLatticePoint(Position, [this] (UInt32 un_index) {
+         if(!Color) {
+            return true;
+         }
+         /* only blocks are in the lattice index */
+         CBlockEntity& cBlock = static_cast<CBlockEntity&>(*Parent.m_vecEntitySnapshots[un_index].Entity);
+         for(const CDirectionalLEDEquippedEntity::SInstance& s_instance :
+             cBlock.GetDirectionalLEDEquippedEntity().GetInstances()) {
+            if(s_instance.LED.GetColor() == *Color) {
+               return true;
+            }
+         }
+         return false;
+      });
    }
 
    /****************************************/
    /****************************************/
 
    bool CDISRoCSLoopFunctions::STimerCondition::IsTrue() {
-      std::map<std::string, UInt32>::iterator itTimer =
-         Parent.m_mapTimers.find(TimerId);
-      if(itTimer != std::end(Parent.m_mapTimers)) {
-         return (itTimer->second == Value);
-      }
-      return false;
+      /* the timer is zero on the step it is started and is incremented on every step */
+      const STimer& sTimer = Parent.m_vecTimers[TimerSlot];
+      return sTimer.Running && (Parent.m_unClock - sTimer.Start == Value);
    }
 
    /****************************************/
    /****************************************/
 
    void CDISRoCSLoopFunctions::SAddEntityAction::Execute() {
-      CEntity* pcEntity = CFactory<CEntity>::New(Configuration.Value());
-      std::string strId;
-      GetNodeAttribute(Configuration, "id", strId);
-      try {
-         Parent.GetSpace().GetEntity(strId);
-         /* if we get here then we need to pick a new id */
-         UInt32 unSuffix = 0;
-         for(;;) {
-            try {
-               Parent.GetSpace().GetEntity(strId + std::to_string(unSuffix));
-               unSuffix++;
-            }
-            catch(CARGoSException& ex) {
-               /* success, no entity with this id */
-               break;
-            }
+      std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+      /* pick an id that is not in use */
+      CEntity::TMap& mapEntities = Parent.GetSpace().GetEntityMapPerId();
+      std::string strId = BaseId;
+      while(mapEntities.count(strId) != 0) {
+         strId = BaseId + std::to_string(NextSuffix++);
+      }
+      /* check the bounding boxes of the nearby entities before touching the physics engines */
+      const SEntityExtents& sExtents = Parent.GetEntityExtents(EntityTypeId);
+      CVector3 cPosition;
+      if(BodyPosition && sExtents.Known) {
+         if(!Parent.FindFreePosition(sExtents, *BodyPosition, SearchRadius, SearchStep, cPosition)) {
+            LOGERR << "[WARNING] Failed to add entity \""
+                   << strId
+                   << "\" since there is no free position within "
+                   << SearchRadius
+                   << " of "
+                   << *BodyPosition
+                   << std::endl;
+            UpdateStatistics(false, tStart);
+            return;
          }
-         SetNodeAttribute(Configuration, "id", strId + std::to_string(unSuffix));
       }
-      catch(CARGoSException& ex) {}
-      pcEntity->Init(Configuration);
-      /* we need to reuse Configuration so set it back to the base id */
-      SetNodeAttribute(Configuration, "id", strId);
+      CEntity* pcEntity = (BodyPosition && sExtents.Known && cPosition != *BodyPosition) ?
+         Create(strId, &cPosition) : Create(strId);
       /* finally, attempt to add the entity to the simulator */
       CallEntityOperation<CSpaceOperationAddEntity, CSpace, void>(Parent.GetSpace(), *pcEntity);
       /* attempt to do a collision check */
+      bool bAdded = true;
       CComposableEntity* pcComposableEntity =
          dynamic_cast<CComposableEntity*>(pcEntity);
       if((pcComposableEntity != nullptr) && pcComposableEntity->HasComponent("body")) {
@@ -417,86 +1540,185 @@ namespace argos {
             pcComposableEntity->GetComponent<CEmbodiedEntity>("body");
          if(cEmbodiedEntity.IsCollidingWithSomething()) {
             LOGERR << "[WARNING] Failed to add entity \"" 
-                   << pcEntity->GetId()
+                   << strId
                    << "\" since it would have collided with something"
                    << std::endl;
+            /* this deletes the entity */
             CallEntityOperation<CSpaceOperationRemoveEntity, CSpace, void>(Parent.GetSpace(), *pcEntity);
+            bAdded = false;
          }
          else {
             /* entity added successfully */
-            Parent.m_vecAddedEntities.push_back(pcEntity);
-            return;
+            Parent.m_vecAddedEntities.push_back(SAddedEntity{pcEntity, this});
+            Parent.InsertEntitySnapshot(*pcEntity);
          }
       }
-      LOGERR << "[WARNING] Could not perform collision test for entity \""
-             << pcEntity->GetId()
-             << std::endl;
+      else {
+         LOGERR << "[WARNING] Could not perform collision test for entity \""
+                << strId
+                << "\""
+                << std::endl;
+         /* the entity is in the space regardless, so that it is removed on reset */
+         Parent.m_vecAddedEntities.push_back(SAddedEntity{pcEntity, this});
+         Parent.InsertEntitySnapshot(*pcEntity);
+      }
+      UpdateStatistics(bAdded, tStart);
    }
 
    /****************************************/
    /****************************************/
 
-   void CDISRoCSLoopFunctions::SRemoveEntityAction::Execute() {
-      try {
-         std::vector<CEntity*> vecCandidateEntities;
-         if(!EntityType.empty()) {
-            for(CEntity* pc_entity : Parent.GetSpace().GetRootEntityVector()) {
-               if(pc_entity->GetTypeDescription() == EntityType) {
-                  if(!EntityId.empty() && (pc_entity->GetId() != EntityId)) {
-                     continue;
-                  }
-                  vecCandidateEntities.push_back(pc_entity);
-               }
-            }
+   CEntity* CDISRoCSLoopFunctions::SAddEntityAction::Create(const std::string& str_id,
+                                                            const CVector3* pc_position,
+                                                            const CQuaternion* pc_orientation) {
+      CEntity* pcEntity = CFactory<CEntity>::New(EntityType);
+      SetNodeAttribute(Configuration, "id", str_id);
+      std::string strPosition;
+      std::string strOrientation;
+      if(pc_position != nullptr || pc_orientation != nullptr) {
+         TConfigurationNode& tBody = GetNode(Configuration, "body");
+         GetNodeAttributeOrDefault(tBody, "position", strPosition, strPosition);
+         GetNodeAttributeOrDefault(tBody, "orientation", strOrientation, strOrientation);
+         std::ostringstream cValue;
+         cValue << std::setprecision(17);
+         if(pc_position != nullptr) {
+            cValue << pc_position->GetX() << ','
+                   << pc_position->GetY() << ','
+                   << pc_position->GetZ();
+            SetNodeAttribute(tBody, "position", cValue.str());
          }
-         else {
-            vecCandidateEntities.push_back(&Parent.GetSpace().GetEntity(EntityId));
+         if(pc_orientation != nullptr) {
+            /* the orientation of the body is specified by the Euler angles in degrees */
+            CRadians cZ, cY, cX;
+            pc_orientation->ToEulerAngles(cZ, cY, cX);
+            cValue.str("");
+            cValue << ToDegrees(cZ).GetValue() << ','
+                   << ToDegrees(cY).GetValue() << ','
+                   << ToDegrees(cX).GetValue();
+            SetNodeAttribute(tBody, "orientation", cValue.str());
          }
-         if(Position) {
-            const CVector3& cPosition = Position->first;
-            const Real& fThreshold = Position->second;
-            for(CEntity* pc_entity : vecCandidateEntities) {
+      }
+      pcEntity->Init(Configuration);
+      /* we need to reuse Configuration so set it back to the template */
+      SetNodeAttribute(Configuration, "id", BaseId);
+      if(pc_position != nullptr || pc_orientation != nullptr) {
+         TConfigurationNode& tBody = GetNode(Configuration, "body");
+         SetNodeAttribute(tBody, "position", strPosition);
+         /* the orientation is optional and defaults to zero */
+         SetNodeAttribute(tBody, "orientation", strOrientation.empty() ? "0,0,0" : strOrientation);
+      }
+      return pcEntity;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::SAddEntityAction::UpdateStatistics(bool b_added,
+                                                                  std::chrono::steady_clock::time_point t_start) {
+      Real fLatency = std::chrono::duration<Real, std::micro>(
+         std::chrono::steady_clock::now() - t_start).count();
+      (b_added ? Spawned : Failed)++;
+      TotalLatency += fLatency;
+      MaxLatency = std::max(MaxLatency, fLatency);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSLoopFunctions::SRemoveEntityAction::Execute() {
+      if(EntityType.empty()) {
+         SInt32 nIndex = Parent.FindEntitySnapshot(EntityId);
+         if(nIndex < 0) {
+            /* not a root entity, fall back to looking it up in the space */
+            CEntity::TMap& mapEntities = Parent.GetSpace().GetEntityMapPerId();
+            CEntity::TMap::iterator itEntity = mapEntities.find(EntityId);
+            if(itEntity == std::end(mapEntities)) {
+               return;
+            }
+            if(Position) {
                CComposableEntity* pcComposableEntity =
-                  dynamic_cast<CComposableEntity*>(pc_entity);
-               if(pcComposableEntity != nullptr && pcComposableEntity->HasComponent("body")) {
-                  CEmbodiedEntity& cEmbodiedEntity =
-                     pcComposableEntity->GetComponent<CEmbodiedEntity>("body");
-                  Real fDistance =
-                     Distance(cPosition, cEmbodiedEntity.GetOriginAnchor().Position);
-                  if(fDistance < fThreshold) {
-                     /* remove entities within threshold of the specified position */
-                     CallEntityOperation<CSpaceOperationRemoveEntity, CSpace, void>(Parent.GetSpace(), *pc_entity);
-                  }
+                  dynamic_cast<CComposableEntity*>(itEntity->second);
+               if(pcComposableEntity == nullptr || !pcComposableEntity->HasComponent("body")) {
+                  return;
+               }
+               CEmbodiedEntity& cEmbodiedEntity =
+                  pcComposableEntity->GetComponent<CEmbodiedEntity>("body");
+               if(Distance(Position->first, cEmbodiedEntity.GetOriginAnchor().Position) >=
+                  Position->second) {
+                  return;
                }
             }
+            Parent.RemoveEntity(*itEntity->second);
+            return;
          }
-         else {
-            for(CEntity* pc_entity : vecCandidateEntities) {
-               /* remove entities */
-               CallEntityOperation<CSpaceOperationRemoveEntity, CSpace, void>(Parent.GetSpace(), *pc_entity);
+         const SEntitySnapshot& sSnapshot = Parent.m_vecEntitySnapshots[nIndex];
+         if(!Position || (sSnapshot.EmbodiedEntity != nullptr &&
+                          Distance(Position->first, sSnapshot.Position) < Position->second)) {
+            Parent.RemoveEntity(*sSnapshot.Entity);
+         }
+         return;
+      }
+      /* removing an entity changes the spatial index and the snapshots, so collect the entities
+         first */
+      std::vector<CEntity*>& vecEntitiesToRemove = Parent.m_vecEntitiesToRemove;
+      vecEntitiesToRemove.clear();
+      auto fnCollect = [this, &vecEntitiesToRemove] (const SEntitySnapshot& s_snapshot) {
+         if(s_snapshot.TypeId != EntityTypeId) {
+            return;
+         }
+         if(!EntityId.empty() &&
+            (s_snapshot.IdHash != EntityIdHash || s_snapshot.Entity->GetId() != EntityId)) {
+            return;
+         }
+         vecEntitiesToRemove.push_back(s_snapshot.Entity);
+      };
+      if(Position) {
+         /* remove entities within threshold of the specified position */
+         const CVector3& cPosition = Position->first;
+         const Real& fThreshold = Position->second;
+         Parent.m_cSpatialIndex.ForEachInSphere(cPosition, fThreshold, [&] (UInt32 un_index) {
+            const SEntitySnapshot& sSnapshot = Parent.m_vecEntitySnapshots[un_index];
+            if(Distance(cPosition, sSnapshot.Position) < fThreshold) {
+               fnCollect(sSnapshot);
             }
+            return false;
+         });
+      }
+      else {
+         for(const SEntitySnapshot& s_snapshot : Parent.m_vecEntitySnapshots) {
+            fnCollect(s_snapshot);
          }
       }
-      catch(CARGoSException& ex) {}
+      for(CEntity* pc_entity : vecEntitiesToRemove) {
+         Parent.RemoveEntity(*pc_entity);
+      }
    }
 
    /****************************************/
    /****************************************/
 
    void CDISRoCSLoopFunctions::SAddTimerAction::Execute() {
-      if(Parent.m_mapTimers.count(TimerId) != 0) {
+      STimer& sTimer = Parent.m_vecTimers[TimerSlot];
+      if(sTimer.Running) {
          LOGERR << "[WARNING] Timer \""
                 << TimerId
                 << "\" already exists and has been reset to zero"
                 << std::endl;
       }
-      Parent.m_mapTimers[TimerId] = 0;
+      sTimer.Running = true;
+      sTimer.Start = Parent.m_unClock;
+      sTimer.Generation++;
+      if(Parent.m_eEvaluation != EEvaluation::POLLING) {
+         Parent.ScheduleTimerEvents(TimerSlot);
+      }
    }
 
    /****************************************/
    /****************************************/
 
    void CDISRoCSLoopFunctions::STerminateAction::Execute() {
+      /* this line is parsed by the batch runner */
+      LOG << "[INFO] Terminating the experiment at step " << Parent.m_unClock << std::endl;
       Parent.m_bTerminate = true;
    }
 
@@ -8,13 +8,25 @@ namespace argos {
    class CDebugEntity;
 }
 
+#include "di_srocs_logger.h"
+#include "di_srocs_metrics.h"
+#include "di_srocs_profiler.h"
+#include "di_srocs_spatial_hash.h"
+#include "di_srocs_thread_pool.h"
+#include "di_srocs_timing_wheel.h"
+
 #include <argos3/core/simulator/space/space.h>
 #include <argos3/core/simulator/loop_functions.h>
 
+#include <argos3/core/utility/datatypes/color.h>
 #include <argos3/core/utility/math/vector3.h>
+#include <argos3/core/utility/math/quaternion.h>
 #include <argos3/core/utility/math/range.h>
 
+#include <chrono>
 #include <experimental/optional>
+#include <iosfwd>
+#include <unordered_map>
 
 namespace argos {
 
@@ -30,12 +42,21 @@ namespace argos {
 
       virtual void Reset() override;
 
+      virtual void Destroy() override;
+
       virtual void PreStep() override;
 
       virtual void PostStep() override;
 
       virtual bool IsExperimentFinished() override;
 
+      /* writes the state of the loop functions (timers, pending actions, enabled conditions and
+         the entities added by the loop functions) relative to the current step */
+      void SaveState(std::ostream& c_stream) const;
+
+      /* the state is restored at the beginning of the next step */
+      void RestoreState(const std::string& str_state);
+
    private:
 
       struct SAction {
@@ -43,35 +64,196 @@ namespace argos {
                  UInt32 un_delay) :
             Parent(c_parent),
             Delay(un_delay) {}
+         virtual ~SAction() {}
          virtual void Execute() = 0;
          CDISRoCSLoopFunctions& Parent;
          const UInt32 Delay = 0;
+#ifdef DI_SROCS_PROFILING
+         UInt32 ProfileStatistic = 0;
+#endif
       };
 
       struct SCondition {
          SCondition(CDISRoCSLoopFunctions& c_parent,
                     bool b_once,
-                    std::vector<std::shared_ptr<SAction> >&& vec_actions) :
+                    std::vector<std::unique_ptr<SAction> >&& vec_actions) :
             Parent(c_parent),
             Once(b_once),
             Enabled(true),
             Actions(std::move(vec_actions)) {}
+         virtual ~SCondition() {}
          virtual bool IsTrue() = 0;
+         /* in the event-driven mode, returns the cached result unless an input has changed */
+         bool Evaluate();
+         /* marks this condition and all conditions that contain it for re-evaluation */
+         void Invalidate();
          CDISRoCSLoopFunctions& Parent;
          bool Once;
          bool Enabled;
-         std::vector<std::shared_ptr<SAction> > Actions;
+         std::vector<std::unique_ptr<SAction> > Actions;
+         /* the condition that contains this condition */
+         SCondition* Owner = nullptr;
+         /* the cached result, only valid in the event-driven mode when Dirty is false */
+         bool Value = false;
+         bool Dirty = true;
+         /* volatile conditions have inputs that are not tracked and are re-evaluated every step */
+         bool Volatile = false;
+      };
+
+      enum class EEvaluation {
+         /* evaluate every enabled condition on every step */
+         POLLING,
+         /* only re-evaluate conditions whose inputs have changed */
+         EVENT,
+         /* use the polling results, but check that the event-driven results are identical */
+         VERIFY,
+      };
+
+      /* a flat copy of the state of a root entity that is refreshed once per PreStep/PostStep,
+         a snapshot keeps its index until its entity is removed and the index is then reused */
+      struct SEntitySnapshot {
+         CEntity* Entity;
+         CEmbodiedEntity* EmbodiedEntity;
+         CDebugEntity* DebugEntity;
+         UInt32 TypeId;
+         size_t IdHash;
+         CVector3 Position;
+         CQuaternion Orientation;
+         /* the pose at the previous sample of the metrics */
+         CVector3 PreviousPosition;
+         CQuaternion PreviousOrientation;
+      };
+
+      /* the axis-aligned bounding box of an entity type relative to the origin of its body */
+      struct SEntityExtents {
+         bool Known = false;
+         CVector3 MinCorner;
+         CVector3 MaxCorner;
+      };
+
+      /* an instruction of the program that the condition trees are compiled into, the program
+         has a single boolean register and the composite conditions become short-circuit jumps */
+      struct SInstruction {
+         enum class EOpcode : UInt8 {
+            ENTITY,
+            TIMER,
+            LATTICE,
+            /* any other condition, evaluated through its virtual interface */
+            CONDITION,
+            CONSTANT,
+            NOT,
+            JUMP_IF_TRUE,
+            JUMP_IF_FALSE,
+            RETURN,
+         };
+         EOpcode Opcode;
+         /* the value of CONSTANT or the target of a jump */
+         UInt32 Operand;
+         SCondition* Condition;
+      };
+
+      /* type ids interned by the constructor, the sorted snapshots are ordered by type id and
+         entity id */
+      enum EEntityTypeId : UInt32 {
+         BUILDERBOT_TYPE_ID = 0,
+         BLOCK_TYPE_ID = 1,
+         /* the type of a free snapshot */
+         FREE_TYPE_ID = static_cast<UInt32>(-1),
       };
 
    private:
 
       std::unique_ptr<SCondition> ParseCondition(TConfigurationNode& t_tree);
 
-      std::shared_ptr<SAction> ParseAction(TConfigurationNode& t_tree);
+      std::unique_ptr<SAction> ParseAction(TConfigurationNode& t_tree);
+
+      std::unique_ptr<SAction> ParseActionType(TConfigurationNode& t_tree);
+
+      UInt32 GetEntityTypeId(const std::string& str_entity_type);
+
+      /* interns a timer id, the slot indexes m_vecTimers and m_vecTimerConditions */
+      UInt32 GetTimerSlot(const std::string& str_timer_id);
+
+      /* refresh the poses in the snapshots or rebuild them if the root entities have been
+         changed outside of the loop functions */
+      void UpdateEntitySnapshots();
+
+      void RebuildEntitySnapshots();
+
+      /* returns the lattice point nearest to the given position */
+      CVector3 SnapToLattice(const CVector3& c_position) const;
+
+      /* calls fn_visitor for every block within the tolerance of the lattice point until it
+         returns true */
+      template<class FVisitor>
+      bool ForEachBlockAtLatticePoint(const CVector3& c_lattice_point, FVisitor fn_visitor) const {
+         return m_cLatticeIndex.ForEachInCell(c_lattice_point, [&] (UInt32 un_index) {
+            return Distance(m_vecEntitySnapshots[un_index].Position, c_lattice_point) < m_fLatticeTolerance &&
+               fn_visitor(un_index);
+         });
+      }
+
+      /* takes a sample of the structures and the robots for the metrics */
+      void UpdateMetrics(UInt32 un_clock);
+
+      SEntitySnapshot MakeEntitySnapshot(CEntity& c_entity);
+
+      static bool CompareEntitySnapshots(const SEntitySnapshot& s_lhs,
+                                         const SEntitySnapshot& s_rhs);
+
+      void InsertEntitySnapshot(CEntity& c_entity);
 
-      void LogEntityToFile(const std::string& str_entity_id,
-                           const CEmbodiedEntity& c_entity,
-                           const CDebugEntity& c_debug_entity);
+      void EraseEntitySnapshot(CEntity& c_entity);
+
+      /* returns the index of the snapshot of the entity with the given id or -1 */
+      SInt32 FindEntitySnapshot(const std::string& str_entity_id) const;
+
+      void RemoveEntity(CEntity& c_entity);
+
+      /* appends the instructions for a condition tree to m_vecProgram */
+      void CompileCondition(SCondition& s_condition);
+
+      /* runs the program from un_entry to the next RETURN */
+      bool ExecuteProgram(UInt32 un_entry);
+
+      /* evaluates a leaf without a virtual call, using the cached value in the event-driven mode */
+      template<class TCondition>
+      bool EvaluateLeaf(TCondition& s_condition);
+
+      /* evaluates a top-level condition according to m_eEvaluation */
+      bool EvaluateCondition(UInt32 un_condition);
+
+      /* invalidates the entity conditions whose result could change because an entity entered
+         (pc_new_position), left (pc_old_position) or moved within the arena */
+      void NotifyEntityChanged(const SEntitySnapshot& s_snapshot,
+                               const CVector3* pc_old_position,
+                               const CVector3* pc_new_position);
+
+      void InvalidateConditions();
+
+      /* schedules the steps at which the conditions on a timer need to be re-evaluated */
+      void ScheduleTimerEvents(UInt32 un_timer_slot);
+
+      /* replaces the current state with a state written by SaveState at step un_clock */
+      void LoadState(std::istream& c_stream, UInt32 un_clock);
+
+      SEntityExtents& GetEntityExtents(UInt32 un_entity_type_id);
+
+      /* checks the bounding boxes of the entities near the given box, this is only a broad
+         phase and the physics engines still have the final say */
+      bool IsVolumeFree(const CVector3& c_min_corner,
+                        const CVector3& c_max_corner) const;
+
+      /* searches for the nearest position within f_search_radius in the horizontal plane where
+         an entity with the given extents does not overlap any other entity */
+      bool FindFreePosition(const SEntityExtents& s_extents,
+                            const CVector3& c_position,
+                            Real f_search_radius,
+                            Real f_search_step,
+                            CVector3& c_free_position) const;
+
+      /* reinserts all snapshots into the spatial index */
+      void RebuildSpatialIndex();
 
    private:
 
@@ -80,9 +262,34 @@ namespace argos {
                           UInt32 un_delay,
                           const TConfigurationNode& t_configuration) :
             SAction(c_parent, un_delay),
-            Configuration(t_configuration) {}
+            Configuration(t_configuration),
+            EntityType(Configuration.Value()),
+            EntityTypeId(c_parent.GetEntityTypeId(EntityType)) {
+            GetNodeAttribute(Configuration, "id", BaseId);
+         }
          virtual void Execute() override;
+         /* creates and initializes an entity from the template, optionally overriding its pose */
+         CEntity* Create(const std::string& str_id,
+                         const CVector3* pc_position = nullptr,
+                         const CQuaternion* pc_orientation = nullptr);
+         void UpdateStatistics(bool b_added, std::chrono::steady_clock::time_point t_start);
          TConfigurationNode Configuration;
+         std::string EntityType;
+         UInt32 EntityTypeId;
+         std::string BaseId;
+         /* the position of the body in the template */
+         std::experimental::optional<CVector3> BodyPosition;
+         /* if the template position is occupied, search for the nearest free position within
+            this radius on rings that are SearchStep apart */
+         Real SearchRadius = 0.0;
+         Real SearchStep = 0.01;
+         /* ids are allocated as BaseId followed by this counter when BaseId is already taken */
+         UInt32 NextSuffix = 0;
+         /* spawn statistics, the latencies are in microseconds */
+         UInt32 Spawned = 0;
+         UInt32 Failed = 0;
+         Real TotalLatency = 0.0;
+         Real MaxLatency = 0.0;
       };
 
       struct SRemoveEntityAction : SAction {
@@ -94,10 +301,14 @@ namespace argos {
             SAction(c_parent, un_delay),
             EntityId(std::move(str_entity_id)),
             EntityType(std::move(str_entity_type)),
+            EntityIdHash(std::hash<std::string>()(EntityId)),
+            EntityTypeId(c_parent.GetEntityTypeId(EntityType)),
             Position(opt_position) {}
          virtual void Execute() override;
          std::string EntityId;
          std::string EntityType;
+         size_t EntityIdHash;
+         UInt32 EntityTypeId;
          std::experimental::optional<std::pair<CVector3, Real>> Position;
       };
 
@@ -106,9 +317,11 @@ namespace argos {
                          UInt32 un_delay,
                          std::string&& str_timer_id) :
             SAction(c_parent, un_delay),
-            TimerId(std::move(str_timer_id)) {}
+            TimerId(std::move(str_timer_id)),
+            TimerSlot(c_parent.GetTimerSlot(TimerId)) {}
          virtual void Execute() override;
          std::string TimerId;
+         UInt32 TimerSlot;
       };
 
       struct STerminateAction : SAction {
@@ -121,10 +334,15 @@ namespace argos {
       struct SAnyCondition : SCondition {
          SAnyCondition(CDISRoCSLoopFunctions& c_parent,
                        bool b_once,
-                       std::vector<std::shared_ptr<SAction> >&& vec_actions,
+                       std::vector<std::unique_ptr<SAction> >&& vec_actions,
                        std::vector<std::unique_ptr<SCondition> >&& vec_conditions) :
             SCondition(c_parent, b_once, std::move(vec_actions)),
-            Conditions(std::move(vec_conditions)) {}
+            Conditions(std::move(vec_conditions)) {
+            for(std::unique_ptr<SCondition>& ptr_condition : Conditions) {
+               ptr_condition->Owner = this;
+               Volatile = Volatile || ptr_condition->Volatile;
+            }
+         }
          virtual bool IsTrue() override;
          std::vector<std::unique_ptr<SCondition> > Conditions;
       };
@@ -132,10 +350,15 @@ namespace argos {
       struct SAllCondition : SCondition {
          SAllCondition(CDISRoCSLoopFunctions& c_parent,
                        bool b_once,
-                       std::vector<std::shared_ptr<SAction> >&& vec_actions,
+                       std::vector<std::unique_ptr<SAction> >&& vec_actions,
                        std::vector<std::unique_ptr<SCondition> >&& vec_conditions) :
             SCondition(c_parent, b_once, std::move(vec_actions)),
-            Conditions(std::move(vec_conditions)) {}
+            Conditions(std::move(vec_conditions)) {
+            for(std::unique_ptr<SCondition>& ptr_condition : Conditions) {
+               ptr_condition->Owner = this;
+               Volatile = Volatile || ptr_condition->Volatile;
+            }
+         }
          virtual bool IsTrue() override;
          std::vector<std::unique_ptr<SCondition> > Conditions;
       };
@@ -143,10 +366,13 @@ namespace argos {
       struct SNotCondition : SCondition {
          SNotCondition(CDISRoCSLoopFunctions& c_parent,
                        bool b_once,
-                       std::vector<std::shared_ptr<SAction> >&& vec_actions,
+                       std::vector<std::unique_ptr<SAction> >&& vec_actions,
                        std::unique_ptr<SCondition>&& ptr_condition) :
             SCondition(c_parent, b_once, std::move(vec_actions)),
-            Condition(std::move(ptr_condition)) {}
+            Condition(std::move(ptr_condition)) {
+            Condition->Owner = this;
+            Volatile = Condition->Volatile;
+         }
          virtual bool IsTrue() override;
          std::unique_ptr<SCondition> Condition;
       };
@@ -154,7 +380,7 @@ namespace argos {
       struct SEntityCondition : SCondition {
          SEntityCondition(CDISRoCSLoopFunctions& c_parent,
                           bool b_once,
-                          std::vector<std::shared_ptr<SAction> >&& vec_actions,
+                          std::vector<std::unique_ptr<SAction> >&& vec_actions,
                           std::string&& str_entity_id,
                           std::string&& str_entity_type,
                           const CVector3& c_position,
@@ -162,38 +388,166 @@ namespace argos {
             SCondition(c_parent, b_once, std::move(vec_actions)),
             EntityId(std::move(str_entity_id)),
             EntityType(std::move(str_entity_type)),
+            EntityIdHash(std::hash<std::string>()(EntityId)),
+            EntityTypeId(c_parent.GetEntityTypeId(EntityType)),
             Position(c_position),
             Threshold(f_threshold) {}
          virtual bool IsTrue() override;
          std::string EntityId;
          std::string EntityType;
+         size_t EntityIdHash;
+         UInt32 EntityTypeId;
          CVector3 Position;
          Real Threshold;
       };
 
+      /* true if a block is within the tolerance of the lattice point nearest to the position */
+      struct SLatticeCondition : SCondition {
+         SLatticeCondition(CDISRoCSLoopFunctions& c_parent,
+                           bool b_once,
+                           std::vector<std::unique_ptr<SAction> >&& vec_actions,
+                           const CVector3& c_position) :
+            SCondition(c_parent, b_once, std::move(vec_actions)),
+            Position(c_parent.SnapToLattice(c_position)) {
+            /* the occupancy and the colors of the blocks are not tracked by events */
+            Volatile = true;
+         }
+         virtual bool IsTrue() override;
+         CVector3 Position;
+         /* if set, one of the LEDs of the block must have this color */
+         std::experimental::optional<CColor> Color;
+      };
+
       struct STimerCondition : SCondition {
          STimerCondition(CDISRoCSLoopFunctions& c_parent,
                          bool b_once,
-                         std::vector<std::shared_ptr<SAction> >&& vec_actions,
+                         std::vector<std::unique_ptr<SAction> >&& vec_actions,
                          std::string&& str_timer_id,
                          UInt32 un_value) :
             SCondition(c_parent, b_once, std::move(vec_actions)),
             TimerId(str_timer_id),
+            TimerSlot(c_parent.GetTimerSlot(TimerId)),
             Value(un_value) {}
          virtual bool IsTrue() override;
          std::string TimerId;
+         UInt32 TimerSlot;
          UInt32 Value;
       };
 
       std::vector<std::unique_ptr<SCondition> > m_vecConditions;
-      std::multimap<UInt32, std::shared_ptr<SAction> > m_mapPendingActions;
-      std::vector<CEntity*> m_vecAddedEntities;
+      /* the compiled conditions and the entry point of each top-level condition */
+      std::vector<SInstruction> m_vecProgram;
+      std::vector<UInt32> m_vecProgramEntries;
+      /* the actions are owned by their conditions, the calendar queue only refers to them */
+      CDISRoCSTimingWheel<SAction*> m_cPendingActions{1024};
+      /* an entity added by the loop functions and the action that added it */
+      struct SAddedEntity {
+         CEntity* Entity;
+         SAddEntityAction* Action;
+      };
+      std::vector<SAddedEntity> m_vecAddedEntities;
+      std::vector<SAddEntityAction*> m_vecAddEntityActions;
+      /* all actions in the order in which they were parsed, so that they can be serialized */
+      std::vector<SAction*> m_vecActions;
+
+      std::vector<SEntitySnapshot> m_vecEntitySnapshots;
+      /* the indices of the free snapshots */
+      std::vector<UInt32> m_vecFreeEntitySnapshots;
+      /* the index of the snapshot of each entity id */
+      std::unordered_map<std::string, UInt32> m_mapEntitySnapshots;
+      /* the indices of the snapshots in the order of CompareEntitySnapshots, for the logging and
+         the metrics */
+      std::vector<UInt32> m_vecSortedEntitySnapshots;
+      /* the root entities of the space as of the last update of the snapshots, to detect the
+         entities that have been added or removed outside of the loop functions */
+      std::vector<CEntity*> m_vecRootEntities;
+      /* the number of each block in the current sample of the metrics, indexed by snapshot */
+      std::vector<UInt32> m_vecBlockNumbers;
+      std::unordered_map<std::string, UInt32> m_mapEntityTypeIds;
+
+      /* uniform grid over the arena indexing the snapshots that have a body */
+      CDISRoCSSpatialHash m_cSpatialIndex;
+      /* grid over the arena whose cells are centered on the points of the block lattice,
+         indexing the snapshots of the blocks */
+      CDISRoCSSpatialHash m_cLatticeIndex;
+      CVector3 m_cLatticeOrigin;
+      /* a block is at a lattice point if it is closer to it than this distance */
+      Real m_fLatticeTolerance = 0.5 * CDISRoCSMetrics::BLOCK_SIDE_LENGTH;
+      /* the extents of each entity type (indexed by type id) and the largest distance from the
+         origin of an entity to a corner of its bounding box */
+      std::vector<SEntityExtents> m_vecEntityTypeExtents;
+      Real m_fMaxEntityExtent = 0.0;
+      /* scratch buffer for the entities removed by a remove_entity action */
+      std::vector<CEntity*> m_vecEntitiesToRemove;
+
+      /* a timer counts the steps since it was started by an add_timer action */
+      struct STimer {
+         bool Running = false;
+         UInt32 Start = 0;
+         /* incremented every time the timer is started, so that events for a previous start
+            of the timer can be ignored */
+         UInt32 Generation = 0;
+      };
+
+      struct STimerEvent {
+         STimerCondition* Condition;
+         UInt32 Generation;
+      };
 
-      std::map<std::string, UInt32> m_mapTimers;
-      std::map<std::string, std::ofstream> m_mapOutputStreams;
+      std::unordered_map<std::string, UInt32> m_mapTimerSlots;
+      std::vector<STimer> m_vecTimers;
+      /* the clock of the current PreStep */
+      UInt32 m_unClock = 0;
+
+      EEvaluation m_eEvaluation = EEvaluation::POLLING;
+      /* set while the verification mode evaluates the conditions by polling */
+      bool m_bForcePolling = false;
+      /* the inputs of the conditions for the event-driven mode */
+      std::vector<SEntityCondition*> m_vecEntityConditions;
+      std::vector<std::vector<STimerCondition*> > m_vecTimerConditions;
+      /* steps at which timer conditions need to be re-evaluated */
+      CDISRoCSTimingWheel<STimerEvent> m_cTimerEvents;
+      /* indexes the entity conditions with a type by their position */
+      CDISRoCSSpatialHash m_cEntityConditionIndex;
+      Real m_fMaxEntityConditionThreshold = 0.0;
+
+      /* evaluates the conditions in parallel, the results are applied in the order of the
+         conditions so that the actions are scheduled as in a serial evaluation */
+      CDISRoCSThreadPool m_cThreadPool;
+      /* the number of conditions that a thread claims at a time */
+      UInt32 m_unParallelGrain = 64;
+      /* one byte per condition rather than a std::vector<bool>, so that threads can write
+         their results concurrently */
+      std::vector<UInt8> m_vecConditionResults;
+
+      CDISRoCSLogger m_cLogger;
+      CDISRoCSMetrics m_cMetrics;
+
+      /* step at which the state is saved, zero disables saving */
+      UInt32 m_unSaveStateAt = 0;
+      std::string m_strStateFile;
+      /* restore the saved state on every reset */
+      bool m_bRestoreStateOnReset = false;
+      std::string m_strSavedState;
+      std::string m_strPendingState;
 
       bool m_bTerminate = false;
 
+#ifdef DI_SROCS_PROFILING
+      CDISRoCSProfiler m_cProfiler;
+      /* the statistics are written into this file on destruction */
+      std::string m_strProfileFile;
+      UInt32 m_unProfileSnapshots;
+      UInt32 m_unProfileConditions;
+      UInt32 m_unProfileActions;
+      UInt32 m_unProfileLogging;
+      UInt32 m_unProfileMetrics;
+      UInt32 m_unProfileEntityConditions;
+      UInt32 m_unProfileTimerConditions;
+      UInt32 m_unProfileLatticeConditions;
+      UInt32 m_unProfileOtherConditions;
+#endif
+
    };
 
 
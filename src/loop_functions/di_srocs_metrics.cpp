@@ -0,0 +1,160 @@
+#include "di_srocs_metrics.h"
+
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/math/angles.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   constexpr Real CDISRoCSMetrics::BLOCK_SIDE_LENGTH;
+
+   /****************************************/
+   /****************************************/
+
+   CDISRoCSMetrics::~CDISRoCSMetrics() {
+      Reset();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSMetrics::Init(TConfigurationNode& t_tree,
+                              const std::string& str_prefix,
+                              Real f_ticks_per_minute) {
+      std::string strPath("metrics.csv");
+      CDegrees cIdleAngle(ToDegrees(CRadians(m_fIdleAngle)));
+      GetNodeAttributeOrDefault(t_tree, "file", strPath, strPath);
+      GetNodeAttributeOrDefault(t_tree, "interval", m_unInterval, m_unInterval);
+      GetNodeAttributeOrDefault(t_tree, "idle_distance", m_fIdleDistance, m_fIdleDistance);
+      GetNodeAttributeOrDefault(t_tree, "idle_angle", cIdleAngle, cIdleAngle);
+      if(m_unInterval == 0) {
+         THROW_ARGOSEXCEPTION("The interval of the metrics must be greater than zero");
+      }
+      m_fIdleAngle = ToRadians(cIdleAngle).GetValue();
+      m_strPath = str_prefix + strPath;
+      m_fTicksPerMinute = f_ticks_per_minute;
+      /* keep the samples of one minute and the sample before them */
+      m_vecHistory.resize(static_cast<UInt32>(std::ceil(m_fTicksPerMinute / m_unInterval)) + 1);
+      m_bEnabled = true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSMetrics::Reset() {
+      /* destroying the stream flushes and closes the file */
+      m_ptrStream.reset();
+      m_unHistoryStart = 0;
+      m_unHistorySize = 0;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSMetrics::BeginSample(UInt32 un_blocks) {
+      m_vecParents.resize(un_blocks);
+      m_vecSizes.resize(un_blocks);
+      for(UInt32 unBlock = 0; unBlock < un_blocks; unBlock++) {
+         m_vecParents[unBlock] = unBlock;
+         m_vecSizes[unBlock] = 1;
+      }
+      m_unRobots = 0;
+      m_unIdleRobots = 0;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSMetrics::JoinBlocks(UInt32 un_block, UInt32 un_other_block) {
+      UInt32 unStructure = FindStructure(un_block);
+      UInt32 unOtherStructure = FindStructure(un_other_block);
+      if(unStructure == unOtherStructure) {
+         return;
+      }
+      /* attach the smaller structure to the larger one */
+      if(m_vecSizes[unStructure] < m_vecSizes[unOtherStructure]) {
+         std::swap(unStructure, unOtherStructure);
+      }
+      m_vecParents[unOtherStructure] = unStructure;
+      m_vecSizes[unStructure] += m_vecSizes[unOtherStructure];
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSMetrics::AddRobot(bool b_idle) {
+      m_unRobots++;
+      if(b_idle) {
+         m_unIdleRobots++;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSMetrics::EndSample(UInt32 un_clock) {
+      UInt32 unStructures = 0;
+      UInt32 unLargestStructure = 0;
+      UInt32 unPlacedBlocks = 0;
+      for(UInt32 unBlock = 0; unBlock < m_vecParents.size(); unBlock++) {
+         if(m_vecParents[unBlock] == unBlock && m_vecSizes[unBlock] > 1) {
+            unStructures++;
+            unPlacedBlocks += m_vecSizes[unBlock];
+            unLargestStructure = std::max(unLargestStructure, m_vecSizes[unBlock]);
+         }
+      }
+      /* compare with the oldest sample of the last minute */
+      if(m_unHistorySize == m_vecHistory.size()) {
+         m_unHistoryStart = (m_unHistoryStart + 1) % m_vecHistory.size();
+         m_unHistorySize--;
+      }
+      m_vecHistory[(m_unHistoryStart + m_unHistorySize) % m_vecHistory.size()] =
+         SHistory{un_clock, unPlacedBlocks};
+      m_unHistorySize++;
+      const SHistory& sOldest = m_vecHistory[m_unHistoryStart];
+      Real fPlacedPerMinute = 0.0;
+      if(un_clock > sOldest.Clock) {
+         fPlacedPerMinute =
+            (static_cast<Real>(unPlacedBlocks) - static_cast<Real>(sOldest.PlacedBlocks)) *
+            m_fTicksPerMinute / (un_clock - sOldest.Clock);
+      }
+      if(!m_ptrStream) {
+         m_ptrStream.reset(new std::ofstream(m_strPath, std::ios_base::out | std::ios_base::trunc));
+         if(!m_ptrStream->is_open()) {
+            THROW_ARGOSEXCEPTION("Could not open \"" << m_strPath << "\" for writing");
+         }
+         *m_ptrStream << "step,blocks,structures,largest_structure,placed_blocks,"
+                      << "placed_blocks_per_minute,robots,idle_robots\n";
+      }
+      /* newline rather than std::endl, the stream is flushed when it is closed */
+      *m_ptrStream << un_clock << ','
+                   << m_vecParents.size() << ','
+                   << unStructures << ','
+                   << unLargestStructure << ','
+                   << unPlacedBlocks << ','
+                   << fPlacedPerMinute << ','
+                   << m_unRobots << ','
+                   << m_unIdleRobots << '\n';
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CDISRoCSMetrics::FindStructure(UInt32 un_block) {
+      /* find the root and halve the path on the way */
+      while(m_vecParents[un_block] != un_block) {
+         m_vecParents[un_block] = m_vecParents[m_vecParents[un_block]];
+         un_block = m_vecParents[un_block];
+      }
+      return un_block;
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
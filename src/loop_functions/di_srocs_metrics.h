@@ -0,0 +1,100 @@
+#ifndef DI_SROCS_METRICS_H
+#define DI_SROCS_METRICS_H
+
+#include <argos3/core/utility/configuration/argos_configuration.h>
+#include <argos3/core/utility/datatypes/datatypes.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace argos {
+
+   /*
+    * Computes a time series of the progress of the structures and writes a line per sample into
+    * a CSV file. The loop functions describe each sample by the number of blocks, the pairs of
+    * blocks at neighbouring lattice points and the robots. Adjacent blocks are merged into
+    * structures with a union-find, a structure being a set of at least two connected blocks.
+    * The blocks placed per minute are the change in the number of blocks that belong to
+    * structures over the last minute of simulated time.
+    */
+   class CDISRoCSMetrics {
+
+   public:
+
+      /* the side length of a block and the spacing of the lattice on which the blocks are placed */
+      static constexpr Real BLOCK_SIDE_LENGTH = 0.055;
+
+   public:
+
+      ~CDISRoCSMetrics();
+
+      void Init(TConfigurationNode& t_tree,
+                const std::string& str_prefix,
+                Real f_ticks_per_minute);
+
+      void Reset();
+
+      /* whether a sample should be taken at the end of the given step */
+      bool IsDue(UInt32 un_clock) const {
+         return m_bEnabled && (un_clock % m_unInterval == 0);
+      }
+
+      /* a robot is idle if it moved less than this distance and turned less than the idle
+         angle since the previous sample */
+      Real GetIdleDistance() const {
+         return m_fIdleDistance;
+      }
+
+      Real GetIdleAngle() const {
+         return m_fIdleAngle;
+      }
+
+      /* starts a sample of un_blocks blocks that are numbered from zero */
+      void BeginSample(UInt32 un_blocks);
+
+      void JoinBlocks(UInt32 un_block, UInt32 un_other_block);
+
+      void AddRobot(bool b_idle);
+
+      /* computes the metrics of the sample and writes them into the file */
+      void EndSample(UInt32 un_clock);
+
+   private:
+
+      UInt32 FindStructure(UInt32 un_block);
+
+   private:
+
+      bool m_bEnabled = false;
+      std::string m_strPath;
+      UInt32 m_unInterval = 1;
+      Real m_fIdleDistance = 0.001;
+      /* in radians */
+      Real m_fIdleAngle = 0.01;
+
+      /* the union-find over the blocks of the current sample */
+      std::vector<UInt32> m_vecParents;
+      std::vector<UInt32> m_vecSizes;
+      UInt32 m_unRobots = 0;
+      UInt32 m_unIdleRobots = 0;
+
+      /* the number of placed blocks of the samples in the last minute, in a ring buffer */
+      struct SHistory {
+         UInt32 Clock;
+         UInt32 PlacedBlocks;
+      };
+      std::vector<SHistory> m_vecHistory;
+      UInt32 m_unHistoryStart = 0;
+      UInt32 m_unHistorySize = 0;
+      Real m_fTicksPerMinute = 0.0;
+
+      /* opened on the first sample, so that a reset starts a new file */
+      std::unique_ptr<std::ofstream> m_ptrStream;
+
+   };
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include "di_srocs_profiler.h"
+
+#include <argos3/core/utility/configuration/argos_exception.h>
+
+#include <fstream>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   const UInt32 CDISRoCSProfiler::HISTOGRAM_BUCKETS;
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CDISRoCSProfiler::Register(const std::string& str_name) {
+      for(UInt32 unIndex = 0; unIndex < m_vecStatistics.size(); unIndex++) {
+         if(m_vecStatistics[unIndex].Name == str_name) {
+            return unIndex;
+         }
+      }
+      m_vecStatistics.emplace_back();
+      m_vecStatistics.back().Name = str_name;
+      return m_vecStatistics.size() - 1;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSProfiler::Write(const std::string& str_path) const {
+      std::ofstream cStream(str_path);
+      if(!cStream.is_open()) {
+         THROW_ARGOSEXCEPTION("Could not open \"" << str_path << "\" for writing");
+      }
+      /* bucket i of the histogram counts the samples in [2^i, 2^(i+1)) ns */
+      cStream << "name,count,total_ns,mean_ns,max_ns";
+      for(UInt32 unBucket = 0; unBucket < HISTOGRAM_BUCKETS; unBucket++) {
+         cStream << ",bucket_" << unBucket;
+      }
+      cStream << '\n';
+      for(const SStatistic& s_statistic : m_vecStatistics) {
+         cStream << s_statistic.Name << ','
+                 << s_statistic.Count << ','
+                 << s_statistic.Total << ','
+                 << (s_statistic.Count > 0 ? s_statistic.Total / s_statistic.Count : 0) << ','
+                 << s_statistic.Maximum;
+         for(UInt64 un_count : s_statistic.Histogram) {
+            cStream << ',' << un_count;
+         }
+         cStream << '\n';
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
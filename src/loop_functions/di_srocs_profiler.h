@@ -0,0 +1,89 @@
+#ifndef DI_SROCS_PROFILER_H
+#define DI_SROCS_PROFILER_H
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/*
+ * Scopes for measuring the time spent in the phases of the loop functions. The scopes and the
+ * profiler member of the loop functions only exist if the loop functions are compiled with
+ * -DDI_SROCS_PROFILING (cmake -DDI_SROCS_PROFILING=ON), otherwise they compile to nothing.
+ */
+#ifdef DI_SROCS_PROFILING
+#define DI_SROCS_PROFILE_CONCATENATE_(A, B) A##B
+#define DI_SROCS_PROFILE_CONCATENATE(A, B) DI_SROCS_PROFILE_CONCATENATE_(A, B)
+#define DI_SROCS_PROFILE_SCOPE(PROFILER, STATISTIC)                  \
+   argos::CDISRoCSProfiler::CScope                                    \
+      DI_SROCS_PROFILE_CONCATENATE(cProfileScope, __LINE__)(PROFILER, STATISTIC)
+#else
+#define DI_SROCS_PROFILE_SCOPE(PROFILER, STATISTIC)
+#endif
+
+namespace argos {
+
+   class CDISRoCSProfiler {
+
+   public:
+
+      /* measures the time between its construction and destruction */
+      class CScope {
+      public:
+         CScope(CDISRoCSProfiler& c_profiler, UInt32 un_statistic) :
+            m_cProfiler(c_profiler),
+            m_unStatistic(un_statistic),
+            m_tStart(std::chrono::steady_clock::now()) {}
+         ~CScope() {
+            m_cProfiler.Record(m_unStatistic, std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - m_tStart).count());
+         }
+      private:
+         CDISRoCSProfiler& m_cProfiler;
+         UInt32 m_unStatistic;
+         std::chrono::steady_clock::time_point m_tStart;
+      };
+
+      /* the histograms have a bucket for each power of two nanoseconds */
+      static const UInt32 HISTOGRAM_BUCKETS = 40;
+
+   public:
+
+      /* returns the index of the statistic with the given name, adding it if necessary */
+      UInt32 Register(const std::string& str_name);
+
+      void Record(UInt32 un_statistic, UInt64 un_nanoseconds) {
+         SStatistic& sStatistic = m_vecStatistics[un_statistic];
+         sStatistic.Count++;
+         sStatistic.Total += un_nanoseconds;
+         if(un_nanoseconds > sStatistic.Maximum) {
+            sStatistic.Maximum = un_nanoseconds;
+         }
+         UInt32 unBucket = 0;
+         while((un_nanoseconds >>= 1) != 0 && unBucket < HISTOGRAM_BUCKETS - 1) {
+            unBucket++;
+         }
+         sStatistic.Histogram[unBucket]++;
+      }
+
+      /* writes a CSV file with a line per statistic */
+      void Write(const std::string& str_path) const;
+
+   private:
+
+      struct SStatistic {
+         std::string Name;
+         UInt64 Count = 0;
+         UInt64 Total = 0;
+         UInt64 Maximum = 0;
+         UInt64 Histogram[HISTOGRAM_BUCKETS] = {};
+      };
+
+      std::vector<SStatistic> m_vecStatistics;
+
+   };
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "di_srocs_spatial_hash.h"
+
+#include <argos3/core/utility/configuration/argos_exception.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   const UInt32 CDISRoCSSpatialHash::NONE;
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSSpatialHash::Init(const CVector3& c_center,
+                                  const CVector3& c_size,
+                                  Real f_cell_size) {
+      if(f_cell_size <= 0.0) {
+         THROW_ARGOSEXCEPTION("The cell size of the spatial index must be greater than zero");
+      }
+      const Real pfCenter[] = {c_center.GetX(), c_center.GetY(), c_center.GetZ()};
+      const Real pfSize[] = {c_size.GetX(), c_size.GetY(), c_size.GetZ()};
+      m_fInverseCellSize = 1.0 / f_cell_size;
+      for(UInt32 unAxis = 0; unAxis < 3; unAxis++) {
+         m_fMinCorner[unAxis] = pfCenter[unAxis] - 0.5 * pfSize[unAxis];
+         m_unCells[unAxis] =
+            std::max<UInt32>(1, static_cast<UInt32>(std::ceil(pfSize[unAxis] * m_fInverseCellSize)));
+      }
+      m_vecCellHeads.assign(m_unCells[0] * m_unCells[1] * m_unCells[2], NONE);
+      m_vecItemCells.clear();
+      m_vecItemNext.clear();
+      m_vecItemPrevious.clear();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSSpatialHash::Clear(UInt32 un_items) {
+      std::fill(std::begin(m_vecCellHeads), std::end(m_vecCellHeads), NONE);
+      m_vecItemCells.assign(un_items, NONE);
+      m_vecItemNext.assign(un_items, NONE);
+      m_vecItemPrevious.assign(un_items, NONE);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSSpatialHash::Reserve(UInt32 un_items) {
+      if(un_items > m_vecItemCells.size()) {
+         m_vecItemCells.resize(un_items, NONE);
+         m_vecItemNext.resize(un_items, NONE);
+         m_vecItemPrevious.resize(un_items, NONE);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSSpatialHash::Insert(UInt32 un_item, const CVector3& c_position) {
+      if(m_vecItemCells[un_item] != NONE) {
+         Unlink(un_item);
+      }
+      Link(un_item, GetCell(c_position));
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSSpatialHash::Remove(UInt32 un_item) {
+      if(m_vecItemCells[un_item] != NONE) {
+         Unlink(un_item);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSSpatialHash::Update(UInt32 un_item, const CVector3& c_position) {
+      UInt32 unCell = GetCell(c_position);
+      if(m_vecItemCells[un_item] != unCell) {
+         if(m_vecItemCells[un_item] != NONE) {
+            Unlink(un_item);
+         }
+         Link(un_item, unCell);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CDISRoCSSpatialHash::GetCoordinate(Real f_position, UInt32 un_axis) const {
+      Real fCoordinate = std::floor((f_position - m_fMinCorner[un_axis]) * m_fInverseCellSize);
+      if(!(fCoordinate > 0.0)) {
+         /* also catches NaN */
+         return 0;
+      }
+      if(fCoordinate >= m_unCells[un_axis]) {
+         return m_unCells[un_axis] - 1;
+      }
+      return static_cast<UInt32>(fCoordinate);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSSpatialHash::Link(UInt32 un_item, UInt32 un_cell) {
+      UInt32 unHead = m_vecCellHeads[un_cell];
+      m_vecItemCells[un_item] = un_cell;
+      m_vecItemPrevious[un_item] = NONE;
+      m_vecItemNext[un_item] = unHead;
+      if(unHead != NONE) {
+         m_vecItemPrevious[unHead] = un_item;
+      }
+      m_vecCellHeads[un_cell] = un_item;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSSpatialHash::Unlink(UInt32 un_item) {
+      UInt32 unNext = m_vecItemNext[un_item];
+      UInt32 unPrevious = m_vecItemPrevious[un_item];
+      if(unPrevious != NONE) {
+         m_vecItemNext[unPrevious] = unNext;
+      }
+      else {
+         m_vecCellHeads[m_vecItemCells[un_item]] = unNext;
+      }
+      if(unNext != NONE) {
+         m_vecItemPrevious[unNext] = unPrevious;
+      }
+      m_vecItemCells[un_item] = NONE;
+      m_vecItemNext[un_item] = NONE;
+      m_vecItemPrevious[un_item] = NONE;
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
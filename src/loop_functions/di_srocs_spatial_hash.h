@@ -0,0 +1,112 @@
+#ifndef DI_SROCS_SPATIAL_HASH_H
+#define DI_SROCS_SPATIAL_HASH_H
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <argos3/core/utility/math/vector3.h>
+
+#include <vector>
+
+namespace argos {
+
+   /*
+    * A uniform grid over the arena that indexes items (e.g., the entity snapshots of the loop
+    * functions) by position. Each cell is the head of an intrusive doubly linked list, so that
+    * inserting, removing and moving items is O(1) and does not allocate memory once the grid
+    * has been sized. Items outside of the arena are stored in the nearest border cell.
+    */
+   class CDISRoCSSpatialHash {
+
+   public:
+
+      static const UInt32 NONE = static_cast<UInt32>(-1);
+
+   public:
+
+      void Init(const CVector3& c_center,
+                const CVector3& c_size,
+                Real f_cell_size);
+
+      /* removes all items and resizes the item arrays */
+      void Clear(UInt32 un_items);
+
+      /* grows the item arrays to un_items, keeping the items that have been inserted */
+      void Reserve(UInt32 un_items);
+
+      void Insert(UInt32 un_item, const CVector3& c_position);
+
+      void Remove(UInt32 un_item);
+
+      /* moves an item into the cell containing the given position if necessary */
+      void Update(UInt32 un_item, const CVector3& c_position);
+
+      /* calls fn_visitor for every item in the cells that overlap the sphere until it returns true,
+         the visitor must check the actual distance since the cells only bound the sphere */
+      template<class FVisitor>
+      bool ForEachInSphere(const CVector3& c_center, Real f_radius, FVisitor fn_visitor) const {
+         UInt32 unMinX = GetCoordinate(c_center.GetX() - f_radius, 0);
+         UInt32 unMaxX = GetCoordinate(c_center.GetX() + f_radius, 0);
+         UInt32 unMinY = GetCoordinate(c_center.GetY() - f_radius, 1);
+         UInt32 unMaxY = GetCoordinate(c_center.GetY() + f_radius, 1);
+         UInt32 unMinZ = GetCoordinate(c_center.GetZ() - f_radius, 2);
+         UInt32 unMaxZ = GetCoordinate(c_center.GetZ() + f_radius, 2);
+         for(UInt32 unZ = unMinZ; unZ <= unMaxZ; unZ++) {
+            for(UInt32 unY = unMinY; unY <= unMaxY; unY++) {
+               for(UInt32 unX = unMinX; unX <= unMaxX; unX++) {
+                  UInt32 unCell = (unZ * m_unCells[1] + unY) * m_unCells[0] + unX;
+                  for(UInt32 unItem = m_vecCellHeads[unCell];
+                      unItem != NONE;
+                      unItem = m_vecItemNext[unItem]) {
+                     if(fn_visitor(unItem)) {
+                        return true;
+                     }
+                  }
+               }
+            }
+         }
+         return false;
+      }
+
+      /* calls fn_visitor for every item in the cell containing the given position until it
+         returns true */
+      template<class FVisitor>
+      bool ForEachInCell(const CVector3& c_position, FVisitor fn_visitor) const {
+         for(UInt32 unItem = m_vecCellHeads[GetCell(c_position)];
+             unItem != NONE;
+             unItem = m_vecItemNext[unItem]) {
+            if(fn_visitor(unItem)) {
+               return true;
+            }
+         }
+         return false;
+      }
+
+   private:
+
+      UInt32 GetCoordinate(Real f_position, UInt32 un_axis) const;
+
+      UInt32 GetCell(const CVector3& c_position) const {
+         return (GetCoordinate(c_position.GetZ(), 2) * m_unCells[1] +
+                 GetCoordinate(c_position.GetY(), 1)) * m_unCells[0] +
+                 GetCoordinate(c_position.GetX(), 0);
+      }
+
+      void Link(UInt32 un_item, UInt32 un_cell);
+
+      void Unlink(UInt32 un_item);
+
+   private:
+
+      Real m_fMinCorner[3] = {0.0, 0.0, 0.0};
+      Real m_fInverseCellSize = 1.0;
+      UInt32 m_unCells[3] = {1, 1, 1};
+
+      std::vector<UInt32> m_vecCellHeads = std::vector<UInt32>(1, NONE);
+      std::vector<UInt32> m_vecItemCells;
+      std::vector<UInt32> m_vecItemNext;
+      std::vector<UInt32> m_vecItemPrevious;
+
+   };
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include "di_srocs_thread_pool.h"
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSThreadPool::Start(UInt32 un_threads) {
+      Stop();
+      m_bStop = false;
+      m_psShares.reset(new SShare[un_threads + 1]);
+      for(UInt32 unParticipant = 1; unParticipant <= un_threads; unParticipant++) {
+         m_vecThreads.emplace_back(&CDISRoCSThreadPool::Work, this, unParticipant, m_unGeneration);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSThreadPool::Stop() {
+      {
+         std::lock_guard<std::mutex> cLock(m_mtxPool);
+         m_bStop = true;
+      }
+      m_cvStart.notify_all();
+      for(std::thread& c_thread : m_vecThreads) {
+         c_thread.join();
+      }
+      m_vecThreads.clear();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSThreadPool::Run(UInt32 un_count,
+                                UInt32 un_grain,
+                                void (*fn_call)(void*, UInt32),
+                                void* pv_task) {
+      UInt32 unParticipants = GetSize();
+      m_fnCall = fn_call;
+      m_pvTask = pv_task;
+      m_unGrain = (un_grain > 0) ? un_grain : 1;
+      m_ptrException = nullptr;
+      for(UInt32 unParticipant = 0; unParticipant < unParticipants; unParticipant++) {
+         SShare& sShare = m_psShares[unParticipant];
+         sShare.Next.store(static_cast<UInt64>(un_count) * unParticipant / unParticipants,
+                           std::memory_order_relaxed);
+         sShare.End = static_cast<UInt64>(un_count) * (unParticipant + 1) / unParticipants;
+      }
+      {
+         std::lock_guard<std::mutex> cLock(m_mtxPool);
+         m_unActive = unParticipants - 1;
+         m_unGeneration++;
+      }
+      m_cvStart.notify_all();
+      Execute(0);
+      {
+         std::unique_lock<std::mutex> cLock(m_mtxPool);
+         m_cvDone.wait(cLock, [this] { return m_unActive == 0; });
+      }
+      if(m_ptrException) {
+         std::rethrow_exception(m_ptrException);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSThreadPool::Work(UInt32 un_participant, UInt64 un_generation) {
+      /* the generation of the last loop that this thread has taken part in */
+      UInt64 unGeneration = un_generation;
+      for(;;) {
+         {
+            std::unique_lock<std::mutex> cLock(m_mtxPool);
+            m_cvStart.wait(cLock, [this, unGeneration] {
+               return m_bStop || m_unGeneration != unGeneration;
+            });
+            if(m_bStop) {
+               return;
+            }
+            unGeneration = m_unGeneration;
+         }
+         Execute(un_participant);
+         {
+            std::lock_guard<std::mutex> cLock(m_mtxPool);
+            if(--m_unActive == 0) {
+               m_cvDone.notify_one();
+            }
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSThreadPool::Execute(UInt32 un_participant) {
+      UInt32 unParticipants = GetSize();
+      /* start with the own share, then visit the shares of the other participants in turn */
+      for(UInt32 unOffset = 0; unOffset < unParticipants; unOffset++) {
+         SShare& sShare = m_psShares[(un_participant + unOffset) % unParticipants];
+         for(;;) {
+            UInt32 unBegin = sShare.Next.fetch_add(m_unGrain, std::memory_order_relaxed);
+            if(unBegin >= sShare.End) {
+               break;
+            }
+            UInt32 unEnd = (sShare.End - unBegin > m_unGrain) ? unBegin + m_unGrain : sShare.End;
+            try {
+               for(UInt32 unIndex = unBegin; unIndex < unEnd; unIndex++) {
+                  m_fnCall(m_pvTask, unIndex);
+               }
+            }
+            catch(...) {
+               std::lock_guard<std::mutex> cLock(m_mtxPool);
+               if(!m_ptrException) {
+                  m_ptrException = std::current_exception();
+               }
+            }
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
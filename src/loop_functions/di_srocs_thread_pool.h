@@ -0,0 +1,88 @@
+#ifndef DI_SROCS_THREAD_POOL_H
+#define DI_SROCS_THREAD_POOL_H
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace argos {
+
+   /*
+    * A pool of threads that executes the iterations of a loop in parallel. Each participant
+    * (the worker threads and the calling thread) starts with an equal share of the iterations
+    * and claims chunks of it through an atomic counter. Once its share is exhausted, it steals
+    * chunks from the shares of the other participants. A loop does not allocate memory.
+    */
+   class CDISRoCSThreadPool {
+
+   public:
+
+      ~CDISRoCSThreadPool() {
+         Stop();
+      }
+
+      /* starts un_threads worker threads in addition to the calling thread */
+      void Start(UInt32 un_threads);
+
+      void Stop();
+
+      /* the number of threads that execute a loop, including the calling thread */
+      UInt32 GetSize() const {
+         return m_vecThreads.size() + 1;
+      }
+
+      /* calls fn_task(i) for every i in [0, un_count) and returns once all calls have completed,
+         the first exception thrown by a call is rethrown on the calling thread */
+      template<class FTask>
+      void ParallelFor(UInt32 un_count, UInt32 un_grain, FTask& fn_task) {
+         Run(un_count, un_grain, [] (void* pv_task, UInt32 un_index) {
+            (*static_cast<FTask*>(pv_task))(un_index);
+         }, &fn_task);
+      }
+
+   private:
+
+      void Run(UInt32 un_count, UInt32 un_grain, void (*fn_call)(void*, UInt32), void* pv_task);
+
+      void Work(UInt32 un_participant, UInt64 un_generation);
+
+      /* executes the chunks of the share of a participant and then steals from the others */
+      void Execute(UInt32 un_participant);
+
+   private:
+
+      /* the share of a participant, padded to a cache line to avoid false sharing between the
+         counters (alignas would need the aligned operator new of C++17) */
+      struct SShare {
+         std::atomic<UInt32> Next;
+         UInt32 End;
+         char Padding[56];
+      };
+
+      std::vector<std::thread> m_vecThreads;
+      std::unique_ptr<SShare[]> m_psShares;
+
+      std::mutex m_mtxPool;
+      std::condition_variable m_cvStart;
+      std::condition_variable m_cvDone;
+      UInt64 m_unGeneration = 0;
+      UInt32 m_unActive = 0;
+      bool m_bStop = false;
+
+      /* the loop that is being executed */
+      void (*m_fnCall)(void*, UInt32) = nullptr;
+      void* m_pvTask = nullptr;
+      UInt32 m_unGrain = 1;
+      std::exception_ptr m_ptrException;
+
+   };
+
+}
+
+#endif
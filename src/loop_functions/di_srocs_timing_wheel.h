@@ -0,0 +1,143 @@
+#ifndef DI_SROCS_TIMING_WHEEL_H
+#define DI_SROCS_TIMING_WHEEL_H
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+
+#include <vector>
+
+namespace argos {
+
+   /*
+    * A hashed timing wheel that schedules items for a given tick. Ticks are hashed into a fixed
+    * number of buckets, each of which is an intrusive FIFO list of nodes from a pool, so that
+    * items for the same tick are expired in the order in which they were scheduled. Scheduling
+    * and expiring items are O(1) per item and do not allocate memory once the pool has grown to
+    * the maximum number of pending items. Expire must be called once for every tick.
+    */
+   template<class T>
+   class CDISRoCSTimingWheel {
+
+   public:
+
+      static const UInt32 NONE = static_cast<UInt32>(-1);
+
+   public:
+
+      /* the number of buckets is rounded up to a power of two */
+      CDISRoCSTimingWheel(UInt32 un_buckets = 256) {
+         UInt32 unBuckets = 1;
+         while(unBuckets < un_buckets) {
+            unBuckets <<= 1;
+         }
+         m_unMask = unBuckets - 1;
+         m_vecBuckets.resize(unBuckets);
+      }
+
+      void Clear() {
+         for(SBucket& s_bucket : m_vecBuckets) {
+            s_bucket.Head = NONE;
+            s_bucket.Tail = NONE;
+         }
+         /* keep the nodes for reuse */
+         m_unFreeNodes = NONE;
+         for(UInt32 unNode = 0; unNode < m_vecNodes.size(); unNode++) {
+            m_vecNodes[unNode].Next = m_unFreeNodes;
+            m_unFreeNodes = unNode;
+         }
+         m_unSize = 0;
+      }
+
+      void Schedule(UInt32 un_tick, const T& t_item) {
+         UInt32 unNode;
+         if(m_unFreeNodes != NONE) {
+            unNode = m_unFreeNodes;
+            m_unFreeNodes = m_vecNodes[unNode].Next;
+            m_vecNodes[unNode].Item = t_item;
+         }
+         else {
+            unNode = m_vecNodes.size();
+            m_vecNodes.push_back(SNode{t_item, 0, NONE});
+         }
+         m_vecNodes[unNode].Tick = un_tick;
+         Append(m_vecBuckets[un_tick & m_unMask], unNode);
+         m_unSize++;
+      }
+
+      /* calls fn_visitor for each item scheduled for un_tick and removes it, items that were
+         scheduled for a tick that has already been expired are discarded */
+      template<class FVisitor>
+      void Expire(UInt32 un_tick, FVisitor fn_visitor) {
+         SBucket& sBucket = m_vecBuckets[un_tick & m_unMask];
+         /* detach the list, items for later rounds of the wheel are appended again */
+         UInt32 unNode = sBucket.Head;
+         sBucket.Head = NONE;
+         sBucket.Tail = NONE;
+         while(unNode != NONE) {
+            UInt32 unNext = m_vecNodes[unNode].Next;
+            UInt32 unTick = m_vecNodes[unNode].Tick;
+            if(unTick == un_tick) {
+               fn_visitor(m_vecNodes[unNode].Item);
+            }
+            if(unTick > un_tick) {
+               Append(sBucket, unNode);
+            }
+            else {
+               m_vecNodes[unNode].Next = m_unFreeNodes;
+               m_unFreeNodes = unNode;
+               m_unSize--;
+            }
+            unNode = unNext;
+         }
+      }
+
+      /* calls fn_visitor(tick, item) for every scheduled item */
+      template<class FVisitor>
+      void ForEach(FVisitor fn_visitor) const {
+         for(const SBucket& s_bucket : m_vecBuckets) {
+            for(UInt32 unNode = s_bucket.Head; unNode != NONE; unNode = m_vecNodes[unNode].Next) {
+               fn_visitor(m_vecNodes[unNode].Tick, m_vecNodes[unNode].Item);
+            }
+         }
+      }
+
+      UInt32 GetSize() const {
+         return m_unSize;
+      }
+
+   private:
+
+      struct SNode {
+         T Item;
+         UInt32 Tick;
+         UInt32 Next;
+      };
+
+      struct SBucket {
+         UInt32 Head = NONE;
+         UInt32 Tail = NONE;
+      };
+
+      void Append(SBucket& s_bucket, UInt32 un_node) {
+         m_vecNodes[un_node].Next = NONE;
+         if(s_bucket.Tail != NONE) {
+            m_vecNodes[s_bucket.Tail].Next = un_node;
+         }
+         else {
+            s_bucket.Head = un_node;
+         }
+         s_bucket.Tail = un_node;
+      }
+
+   private:
+
+      UInt32 m_unMask;
+      std::vector<SBucket> m_vecBuckets;
+      std::vector<SNode> m_vecNodes;
+      UInt32 m_unFreeNodes = NONE;
+      UInt32 m_unSize = 0;
+
+   };
+
+}
+
+#endif
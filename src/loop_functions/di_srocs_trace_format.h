@@ -0,0 +1,222 @@
+#ifndef DI_SROCS_TRACE_FORMAT_H
+#define DI_SROCS_TRACE_FORMAT_H
+
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/datatypes/datatypes.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Binary trace format written by CDISRoCSLogger when <log format="binary"/>
+ *
+ * The file starts with a STraceFileHeader and is followed by a sequence of chunks.
+ * Each chunk starts with a STraceChunkHeader and its payload is padded to a multiple
+ * of eight bytes so that the columns of a mapped file are always aligned:
+ *
+ * ENTITY: entity index (Index), followed by the entity id (Size bytes)
+ * STRING: string index (Index), followed by the string (Size bytes)
+ * BLOCK:  Size records stored as columns in the following order:
+ *         double position x, y, z [Size]
+ *         double orientation w, x, y, z [Size]
+ *         UInt32 clock [Size], UInt32 entity index [Size], UInt32 string index [Size]
+ *
+ * Entity and string chunks always precede the first block that references them.
+ * The strings are the raw contents of the "loop_functions" debug buffers.
+ */
+
+namespace argos {
+
+   static const char TRACE_MAGIC[8] = {'D', 'I', 'T', 'R', 'A', 'C', 'E', '\0'};
+
+   static const UInt32 TRACE_VERSION = 1;
+
+   enum class ETraceChunk : UInt32 {
+      ENTITY = 1,
+      STRING = 2,
+      BLOCK = 3,
+   };
+
+   struct STraceFileHeader {
+      char Magic[8];
+      UInt32 Version;
+      UInt32 Reserved;
+   };
+
+   struct STraceChunkHeader {
+      UInt32 Type;
+      UInt32 Size;
+      UInt32 Index;
+      UInt32 Reserved;
+   };
+
+   /****************************************/
+   /****************************************/
+
+   inline size_t GetTracePadding(size_t un_size) {
+      return (8 - (un_size % 8)) % 8;
+   }
+
+   inline size_t GetTraceBlockSize(UInt32 un_records) {
+      size_t unSize = un_records * (7 * sizeof(double) + 3 * sizeof(UInt32));
+      return unSize + GetTracePadding(unSize);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   struct STraceBlock {
+      UInt32 Records = 0;
+      const double* Position[3];
+      const double* Orientation[4];
+      const UInt32* Clock;
+      const UInt32* Entity;
+      const UInt32* String;
+   };
+
+   /****************************************/
+   /****************************************/
+
+   class CDISRoCSTraceReader {
+
+   public:
+
+      CDISRoCSTraceReader(const std::string& str_path) {
+         m_nFileDescriptor = ::open(str_path.c_str(), O_RDONLY);
+         if(m_nFileDescriptor < 0) {
+            THROW_ARGOSEXCEPTION("Could not open \"" << str_path << "\": " << ::strerror(errno));
+         }
+         struct stat sStat;
+         if(::fstat(m_nFileDescriptor, &sStat) < 0) {
+            ::close(m_nFileDescriptor);
+            THROW_ARGOSEXCEPTION("Could not stat \"" << str_path << "\": " << ::strerror(errno));
+         }
+         m_unSize = sStat.st_size;
+         if(m_unSize < sizeof(STraceFileHeader)) {
+            ::close(m_nFileDescriptor);
+            THROW_ARGOSEXCEPTION("\"" << str_path << "\" is not a trace file");
+         }
+         void* pvData = ::mmap(nullptr, m_unSize, PROT_READ, MAP_PRIVATE, m_nFileDescriptor, 0);
+         if(pvData == MAP_FAILED) {
+            ::close(m_nFileDescriptor);
+            THROW_ARGOSEXCEPTION("Could not map \"" << str_path << "\": " << ::strerror(errno));
+         }
+         m_pchData = static_cast<const char*>(pvData);
+         const STraceFileHeader* psHeader =
+            reinterpret_cast<const STraceFileHeader*>(m_pchData);
+         if(::memcmp(psHeader->Magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+            psHeader->Version != TRACE_VERSION) {
+            Close();
+            THROW_ARGOSEXCEPTION("\"" << str_path << "\" is not a version "
+                                 << TRACE_VERSION << " trace file");
+         }
+         m_unOffset = sizeof(STraceFileHeader);
+      }
+
+      ~CDISRoCSTraceReader() {
+         Close();
+      }
+
+      CDISRoCSTraceReader(const CDISRoCSTraceReader&) = delete;
+
+      CDISRoCSTraceReader& operator=(const CDISRoCSTraceReader&) = delete;
+
+      /* advances to the next block of records, updating the entity and string tables on the way */
+      bool NextBlock(STraceBlock& s_block) {
+         while(m_unOffset + sizeof(STraceChunkHeader) <= m_unSize) {
+            const STraceChunkHeader* psChunk =
+               reinterpret_cast<const STraceChunkHeader*>(m_pchData + m_unOffset);
+            const char* pchPayload = m_pchData + m_unOffset + sizeof(STraceChunkHeader);
+            size_t unPayloadSize = 0;
+            switch(static_cast<ETraceChunk>(psChunk->Type)) {
+            case ETraceChunk::ENTITY:
+            case ETraceChunk::STRING:
+               unPayloadSize = psChunk->Size + GetTracePadding(psChunk->Size);
+               break;
+            case ETraceChunk::BLOCK:
+               unPayloadSize = GetTraceBlockSize(psChunk->Size);
+               break;
+            default:
+               THROW_ARGOSEXCEPTION("Unknown chunk type " << psChunk->Type <<
+                                    " at offset " << m_unOffset);
+            }
+            if(pchPayload + unPayloadSize > m_pchData + m_unSize) {
+               /* a truncated trace, e.g. the simulation was killed while writing */
+               return false;
+            }
+            m_unOffset += sizeof(STraceChunkHeader) + unPayloadSize;
+            if(psChunk->Type == static_cast<UInt32>(ETraceChunk::BLOCK)) {
+               UInt32 unRecords = psChunk->Size;
+               const double* pfColumns = reinterpret_cast<const double*>(pchPayload);
+               for(UInt32 unAxis = 0; unAxis < 3; unAxis++) {
+                  s_block.Position[unAxis] = pfColumns + unAxis * unRecords;
+               }
+               for(UInt32 unAxis = 0; unAxis < 4; unAxis++) {
+                  s_block.Orientation[unAxis] = pfColumns + (3 + unAxis) * unRecords;
+               }
+               const UInt32* punColumns =
+                  reinterpret_cast<const UInt32*>(pfColumns + 7 * unRecords);
+               s_block.Clock = punColumns;
+               s_block.Entity = punColumns + unRecords;
+               s_block.String = punColumns + 2 * unRecords;
+               s_block.Records = unRecords;
+               return true;
+            }
+            std::vector<std::string>& vecTable =
+               (psChunk->Type == static_cast<UInt32>(ETraceChunk::ENTITY)) ? m_vecEntityIds : m_vecStrings;
+            /* the writer numbers the entries in the order in which they are written */
+            if(psChunk->Index > vecTable.size()) {
+               THROW_ARGOSEXCEPTION("Invalid table index " << psChunk->Index <<
+                                    " at offset " << m_unOffset - sizeof(STraceChunkHeader) - unPayloadSize);
+            }
+            if(psChunk->Index == vecTable.size()) {
+               vecTable.emplace_back();
+            }
+            vecTable[psChunk->Index].assign(pchPayload, psChunk->Size);
+         }
+         return false;
+      }
+
+      const std::vector<std::string>& GetEntityIds() const {
+         return m_vecEntityIds;
+      }
+
+      const std::vector<std::string>& GetStrings() const {
+         return m_vecStrings;
+      }
+
+   private:
+
+      void Close() {
+         if(m_pchData != nullptr) {
+            ::munmap(const_cast<char*>(m_pchData), m_unSize);
+            m_pchData = nullptr;
+         }
+         if(m_nFileDescriptor >= 0) {
+            ::close(m_nFileDescriptor);
+            m_nFileDescriptor = -1;
+         }
+      }
+
+   private:
+
+      int m_nFileDescriptor = -1;
+      const char* m_pchData = nullptr;
+      size_t m_unSize = 0;
+      size_t m_unOffset = 0;
+
+      std::vector<std::string> m_vecEntityIds;
+      std::vector<std::string> m_vecStrings;
+
+   };
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * Converts a binary trace written with <log format="binary"/> back into the CSV
+ * files that the loop functions write with <log format="csv"/>
+ *
+ * Usage: di_srocs_trace_to_csv [-o directory] [-i file] trace
+ *
+ * -o directory  write one <entity id>.csv file per entity into directory
+ * -i file       write all entities into a single file, each line prefixed by the entity id
+ */
+
+#include "di_srocs_trace_format.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace argos;
+
+/****************************************/
+/****************************************/
+
+void WriteRecord(std::ostream& c_stream,
+                 const STraceBlock& s_block,
+                 UInt32 un_record,
+                 const std::string& str_buffer) {
+   c_stream << s_block.Clock[un_record]
+            << ","
+            << s_block.Position[0][un_record]
+            << ","
+            << s_block.Position[1][un_record]
+            << ","
+            << s_block.Position[2][un_record]
+            << ",";
+   /* the loop functions remove all newlines from the debug buffer */
+   for(char ch_character : str_buffer) {
+      if(ch_character != '\n') {
+         c_stream.put(ch_character);
+      }
+   }
+   c_stream.put('\n');
+}
+
+/****************************************/
+/****************************************/
+
+int main(int n_argc, char** ppch_argv) {
+   std::string strDirectory(".");
+   std::string strInterleavedPath;
+   std::string strTracePath;
+   for(int i = 1; i < n_argc; i++) {
+      std::string strArgument(ppch_argv[i]);
+      if(strArgument == "-o" && i + 1 < n_argc) {
+         strDirectory = ppch_argv[++i];
+      }
+      else if(strArgument == "-i" && i + 1 < n_argc) {
+         strInterleavedPath = ppch_argv[++i];
+      }
+      else if(strTracePath.empty() && !strArgument.empty() && strArgument.front() != '-') {
+         strTracePath = strArgument;
+      }
+      else {
+         strTracePath.clear();
+         break;
+      }
+   }
+   if(strTracePath.empty()) {
+      std::cerr << "Usage: " << ppch_argv[0] << " [-o directory] [-i file] trace" << std::endl;
+      return EXIT_FAILURE;
+   }
+   try {
+      CDISRoCSTraceReader cReader(strTracePath);
+      std::ofstream cInterleavedStream;
+      if(!strInterleavedPath.empty()) {
+         cInterleavedStream.open(strInterleavedPath, std::ios_base::out | std::ios_base::trunc);
+         if(!cInterleavedStream.is_open()) {
+            THROW_ARGOSEXCEPTION("Could not open \"" << strInterleavedPath << "\" for writing");
+         }
+      }
+      std::vector<std::unique_ptr<std::ofstream> > vecEntityStreams;
+      STraceBlock sBlock;
+      while(cReader.NextBlock(sBlock)) {
+         const std::vector<std::string>& vecEntityIds = cReader.GetEntityIds();
+         const std::vector<std::string>& vecStrings = cReader.GetStrings();
+         for(UInt32 unRecord = 0; unRecord < sBlock.Records; unRecord++) {
+            UInt32 unEntity = sBlock.Entity[unRecord];
+            const std::string& strBuffer = vecStrings.at(sBlock.String[unRecord]);
+            if(cInterleavedStream.is_open()) {
+               cInterleavedStream << vecEntityIds.at(unEntity) << ",";
+               WriteRecord(cInterleavedStream, sBlock, unRecord, strBuffer);
+               continue;
+            }
+            if(vecEntityStreams.size() <= unEntity) {
+               vecEntityStreams.resize(unEntity + 1);
+            }
+            std::unique_ptr<std::ofstream>& ptrStream = vecEntityStreams[unEntity];
+            if(!ptrStream) {
+               const std::string strPath =
+                  strDirectory + "/" + vecEntityIds.at(unEntity) + ".csv";
+               ptrStream = std::make_unique<std::ofstream>(strPath,
+                                                          std::ios_base::out |
+                                                          std::ios_base::trunc);
+               if(!ptrStream->is_open()) {
+                  THROW_ARGOSEXCEPTION("Could not open \"" << strPath << "\" for writing");
+               }
+            }
+            WriteRecord(*ptrStream, sBlock, unRecord, strBuffer);
+         }
+      }
+   }
+   catch(CARGoSException& ex) {
+      std::cerr << "Error: " << ex.what() << std::endl;
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
+
+/****************************************/
+/****************************************/
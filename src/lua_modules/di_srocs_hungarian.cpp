@@ -0,0 +1,189 @@
+/*
+ * A Lua module that solves the assignment problem of Tools/Hungarian.lua natively.
+ *
+ * The cost matrix is copied from the nested Lua tables into a flat array of doubles and solved
+ * with the shortest augmenting path variant of the Hungarian algorithm (Jonker-Volgenant) in
+ * O(n^3). The arrays are kept between calls, so that only the two result tables are allocated.
+ *
+ *    local hungarian = require("di_srocs_hungarian")
+ *    local match_of_X, match_of_Y = hungarian.solve(costMat, N, "MIN")
+ *
+ * Like Hungarian.lua, missing entries of the N x N cost matrix are zero, the costs are
+ * maximized unless the third argument is "MIN", match_of_X[i] is the column assigned to row i
+ * and match_of_Y[j] is the row assigned to column j.
+ */
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+}
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   class CDISRoCSHungarian {
+
+   public:
+
+      /* resizes the cost matrix to un_size x un_size, the rows and columns are numbered from one */
+      void Resize(UInt32 un_size) {
+         m_unSize = un_size;
+         m_vecCosts.assign(un_size * un_size, 0.0);
+      }
+
+      double& GetCost(UInt32 un_row, UInt32 un_column) {
+         return m_vecCosts[(un_row - 1) * m_unSize + (un_column - 1)];
+      }
+
+      /* finds the assignment of minimal cost, afterwards GetRowOfColumn(j) is the row assigned to
+         column j */
+      void Solve();
+
+      UInt32 GetRowOfColumn(UInt32 un_column) const {
+         return m_vecRowOfColumn[un_column];
+      }
+
+   private:
+
+      UInt32 m_unSize = 0;
+      std::vector<double> m_vecCosts;
+      /* the potentials of the rows and the columns, index zero is a virtual column */
+      std::vector<double> m_vecRowPotentials;
+      std::vector<double> m_vecColumnPotentials;
+      std::vector<UInt32> m_vecRowOfColumn;
+      /* the previous column on the shortest path to each column and the length of that path */
+      std::vector<UInt32> m_vecPreviousColumn;
+      std::vector<double> m_vecMinimumSlack;
+      std::vector<UInt8> m_vecVisited;
+
+   };
+
+   /****************************************/
+   /****************************************/
+
+   void CDISRoCSHungarian::Solve() {
+      const double fInfinity = std::numeric_limits<double>::infinity();
+      m_vecRowPotentials.assign(m_unSize + 1, 0.0);
+      m_vecColumnPotentials.assign(m_unSize + 1, 0.0);
+      m_vecRowOfColumn.assign(m_unSize + 1, 0);
+      m_vecPreviousColumn.assign(m_unSize + 1, 0);
+      m_vecMinimumSlack.resize(m_unSize + 1);
+      m_vecVisited.resize(m_unSize + 1);
+      for(UInt32 unRow = 1; unRow <= m_unSize; unRow++) {
+         /* grow a tree of shortest paths from the virtual column holding the new row until it
+            reaches an unassigned column */
+         m_vecRowOfColumn[0] = unRow;
+         UInt32 unColumn = 0;
+         std::fill(m_vecMinimumSlack.begin(), m_vecMinimumSlack.end(), fInfinity);
+         std::fill(m_vecVisited.begin(), m_vecVisited.end(), 0);
+         do {
+            m_vecVisited[unColumn] = 1;
+            UInt32 unPathRow = m_vecRowOfColumn[unColumn];
+            double fDelta = fInfinity;
+            UInt32 unNextColumn = 0;
+            const double* pfCosts = &m_vecCosts[(unPathRow - 1) * m_unSize];
+            for(UInt32 unOther = 1; unOther <= m_unSize; unOther++) {
+               if(!m_vecVisited[unOther]) {
+                  double fSlack = pfCosts[unOther - 1] -
+                     m_vecRowPotentials[unPathRow] - m_vecColumnPotentials[unOther];
+                  if(fSlack < m_vecMinimumSlack[unOther]) {
+                     m_vecMinimumSlack[unOther] = fSlack;
+                     m_vecPreviousColumn[unOther] = unColumn;
+                  }
+                  if(m_vecMinimumSlack[unOther] < fDelta) {
+                     fDelta = m_vecMinimumSlack[unOther];
+                     unNextColumn = unOther;
+                  }
+               }
+            }
+            /* update the potentials so that the new column is reached by a tight edge */
+            for(UInt32 unOther = 0; unOther <= m_unSize; unOther++) {
+               if(m_vecVisited[unOther]) {
+                  m_vecRowPotentials[m_vecRowOfColumn[unOther]] += fDelta;
+                  m_vecColumnPotentials[unOther] -= fDelta;
+               }
+               else {
+                  m_vecMinimumSlack[unOther] -= fDelta;
+               }
+            }
+            unColumn = unNextColumn;
+         } while(m_vecRowOfColumn[unColumn] != 0);
+         /* flip the assignments along the augmenting path */
+         do {
+            UInt32 unPreviousColumn = m_vecPreviousColumn[unColumn];
+            m_vecRowOfColumn[unColumn] = m_vecRowOfColumn[unPreviousColumn];
+            unColumn = unPreviousColumn;
+         } while(unColumn != 0);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   static int LuaSolve(lua_State* pt_lua_state) {
+      luaL_checktype(pt_lua_state, 1, LUA_TTABLE);
+      lua_Integer nSize = luaL_checkinteger(pt_lua_state, 2);
+      bool bMinimize = (std::strcmp(luaL_optstring(pt_lua_state, 3, "MAX"), "MIN") == 0);
+      luaL_argcheck(pt_lua_state, nSize >= 0, 2, "the size must not be negative");
+      UInt32 unSize = static_cast<UInt32>(nSize);
+      /* one solver per thread, since the Lua controllers can be stepped in parallel */
+      static thread_local CDISRoCSHungarian cHungarian;
+      cHungarian.Resize(unSize);
+      /* copy the cost matrix, missing rows and entries are zero */
+      for(UInt32 unRow = 1; unRow <= unSize; unRow++) {
+         if(lua_rawgeti(pt_lua_state, 1, unRow) == LUA_TTABLE) {
+            for(UInt32 unColumn = 1; unColumn <= unSize; unColumn++) {
+               if(lua_rawgeti(pt_lua_state, -1, unColumn) != LUA_TNIL) {
+                  int nIsNumber = 0;
+                  double fCost = lua_tonumberx(pt_lua_state, -1, &nIsNumber);
+                  if(!nIsNumber || !std::isfinite(fCost)) {
+                     return luaL_error(pt_lua_state,
+                                       "the cost at (%d, %d) is not a finite number",
+                                       static_cast<int>(unRow),
+                                       static_cast<int>(unColumn));
+                  }
+                  /* maximizing the costs is minimizing their negation */
+                  cHungarian.GetCost(unRow, unColumn) = bMinimize ? fCost : -fCost;
+               }
+               lua_pop(pt_lua_state, 1);
+            }
+         }
+         lua_pop(pt_lua_state, 1);
+      }
+      cHungarian.Solve();
+      /* return match_of_X and match_of_Y */
+      lua_createtable(pt_lua_state, unSize, 0);
+      lua_createtable(pt_lua_state, unSize, 0);
+      for(UInt32 unColumn = 1; unColumn <= unSize; unColumn++) {
+         UInt32 unRow = cHungarian.GetRowOfColumn(unColumn);
+         lua_pushinteger(pt_lua_state, unColumn);
+         lua_rawseti(pt_lua_state, -3, unRow);
+         lua_pushinteger(pt_lua_state, unRow);
+         lua_rawseti(pt_lua_state, -2, unColumn);
+      }
+      return 2;
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
+
+extern "C" int luaopen_di_srocs_hungarian(lua_State* pt_lua_state) {
+   static const luaL_Reg psFunctions[] = {
+      {"solve", argos::LuaSolve},
+      {nullptr, nullptr}
+   };
+   luaL_newlib(pt_lua_state, psFunctions);
+   return 1;
+}
@@ -0,0 +1,337 @@
+#include "di_qtopengl_batch_renderer.h"
+
+#include <argos3/core/utility/logging/argos_log.h>
+#include <argos3/core/utility/math/angles.h>
+
+#include <QOpenGLContext>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#define GL_NUMBER_VERTICES 36u
+
+namespace argos {
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   static const char* VERTEX_SHADER =
+      "#version 120\n"
+      "attribute vec4 a_vertex;\n"
+      "attribute mat4 a_transform;\n"
+      "attribute vec2 a_radius_scales;\n"
+      "attribute vec4 a_color;\n"
+      "varying vec4 v_color;\n"
+      "void main() {\n"
+      "   float fRadiusScale = mix(a_radius_scales.x, a_radius_scales.y, a_vertex.w);\n"
+      "   vec4 cVertex = vec4(a_vertex.xy * fRadiusScale, a_vertex.z, 1.0);\n"
+      "   gl_Position = gl_ModelViewProjectionMatrix * a_transform * cVertex;\n"
+      "   v_color = a_color;\n"
+      "}\n";
+
+   static const char* FRAGMENT_SHADER =
+      "#version 120\n"
+      "varying vec4 v_color;\n"
+      "void main() {\n"
+      "   gl_FragColor = v_color;\n"
+      "}\n";
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   bool CDIQtOpenGLBatchRenderer::IsSupported() {
+      if(!m_bInitialized) {
+         m_bInitialized = true;
+         m_bSupported = Init();
+      }
+      return m_bSupported;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   bool CDIQtOpenGLBatchRenderer::Init() {
+      QOpenGLContext* pcContext = QOpenGLContext::currentContext();
+      if(pcContext == nullptr || pcContext->isOpenGLES()) {
+         return false;
+      }
+      initializeOpenGLFunctions();
+      /* the entry points are core since OpenGL 3.3 and have the suffix ARB in the extensions */
+      m_fnVertexAttribDivisor = reinterpret_cast<void (QOPENGLF_APIENTRYP)(GLuint, GLuint)>(
+         pcContext->getProcAddress("glVertexAttribDivisor"));
+      if(m_fnVertexAttribDivisor == nullptr) {
+         m_fnVertexAttribDivisor = reinterpret_cast<void (QOPENGLF_APIENTRYP)(GLuint, GLuint)>(
+            pcContext->getProcAddress("glVertexAttribDivisorARB"));
+      }
+      m_fnDrawArraysInstanced =
+         reinterpret_cast<void (QOPENGLF_APIENTRYP)(GLenum, GLint, GLsizei, GLsizei)>(
+            pcContext->getProcAddress("glDrawArraysInstanced"));
+      if(m_fnDrawArraysInstanced == nullptr) {
+         m_fnDrawArraysInstanced =
+            reinterpret_cast<void (QOPENGLF_APIENTRYP)(GLenum, GLint, GLsizei, GLsizei)>(
+               pcContext->getProcAddress("glDrawArraysInstancedARB"));
+      }
+      if(m_fnVertexAttribDivisor == nullptr || m_fnDrawArraysInstanced == nullptr) {
+         LOGERR << "[WARNING] Instanced rendering is not supported, "
+                << "the annotations are drawn with display lists" << std::endl;
+         return false;
+      }
+      /* the vertices use attribute 0, which aliases the fixed-function vertex position */
+      m_cProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, VERTEX_SHADER);
+      m_cProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, FRAGMENT_SHADER);
+      m_cProgram.bindAttributeLocation("a_vertex", 0);
+      if(!m_cProgram.link()) {
+         LOGERR << "[WARNING] Could not link the shader for instanced rendering, "
+                << "the annotations are drawn with display lists: "
+                << m_cProgram.log().toStdString() << std::endl;
+         return false;
+      }
+      m_nVertexAttribute = m_cProgram.attributeLocation("a_vertex");
+      m_nTransformAttribute = m_cProgram.attributeLocation("a_transform");
+      m_nRadiusScalesAttribute = m_cProgram.attributeLocation("a_radius_scales");
+      m_nColorAttribute = m_cProgram.attributeLocation("a_color");
+      if(m_nVertexAttribute < 0 || m_nTransformAttribute < 0 ||
+         m_nRadiusScalesAttribute < 0 || m_nColorAttribute < 0) {
+         return false;
+      }
+      /* build the shapes */
+      MakeCylinder();
+      MakeCone();
+      MakeRing();
+      m_cMeshBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+      m_cInstanceBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+      if(!m_cMeshBuffer.create() || !m_cInstanceBuffer.create()) {
+         return false;
+      }
+      m_cMeshBuffer.bind();
+      m_cMeshBuffer.allocate(m_vecMesh.data(), m_vecMesh.size() * sizeof(GLfloat));
+      m_cMeshBuffer.release();
+      return true;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLBatchRenderer::Add(EShape e_shape,
+                                      const GLfloat* pf_transform,
+                                      const CColor& c_color,
+                                      GLfloat f_inner_scale,
+                                      GLfloat f_outer_scale) {
+      std::vector<SInstance>& vecInstances = m_pvecInstances[static_cast<UInt32>(e_shape)];
+      vecInstances.emplace_back();
+      SInstance& sInstance = vecInstances.back();
+      std::copy(pf_transform, pf_transform + 16, sInstance.Transform);
+      sInstance.RadiusScales[0] = f_inner_scale;
+      sInstance.RadiusScales[1] = f_outer_scale;
+      /* the annotations are drawn half transparent */
+      sInstance.Color[0] = c_color.GetRed();
+      sInstance.Color[1] = c_color.GetGreen();
+      sInstance.Color[2] = c_color.GetBlue();
+      sInstance.Color[3] = 128u;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLBatchRenderer::Flush() {
+      size_t unInstances = 0;
+      for(const std::vector<SInstance>& vec_instances : m_pvecInstances) {
+         unInstances += vec_instances.size();
+      }
+      if(unInstances == 0) {
+         return;
+      }
+      glDisable(GL_LIGHTING);
+      glEnable(GL_BLEND);
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      m_cProgram.bind();
+      /* the vertices of the shapes */
+      m_cMeshBuffer.bind();
+      glEnableVertexAttribArray(m_nVertexAttribute);
+      glVertexAttribPointer(m_nVertexAttribute, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), nullptr);
+      /* stream the instances of all shapes into one buffer */
+      m_cInstanceBuffer.bind();
+      m_cInstanceBuffer.allocate(unInstances * sizeof(SInstance));
+      size_t unOffset = 0;
+      for(const std::vector<SInstance>& vec_instances : m_pvecInstances) {
+         m_cInstanceBuffer.write(unOffset, vec_instances.data(), vec_instances.size() * sizeof(SInstance));
+         unOffset += vec_instances.size() * sizeof(SInstance);
+      }
+      GLuint punInstanceAttributes[] = {
+         static_cast<GLuint>(m_nTransformAttribute),
+         static_cast<GLuint>(m_nTransformAttribute + 1),
+         static_cast<GLuint>(m_nTransformAttribute + 2),
+         static_cast<GLuint>(m_nTransformAttribute + 3),
+         static_cast<GLuint>(m_nRadiusScalesAttribute),
+         static_cast<GLuint>(m_nColorAttribute),
+      };
+      for(GLuint un_attribute : punInstanceAttributes) {
+         glEnableVertexAttribArray(un_attribute);
+         m_fnVertexAttribDivisor(un_attribute, 1);
+      }
+      unOffset = 0;
+      for(UInt32 unShape = 0; unShape < NUMBER_OF_SHAPES; unShape++) {
+         std::vector<SInstance>& vecInstances = m_pvecInstances[unShape];
+         if(vecInstances.empty()) {
+            continue;
+         }
+         /* a matrix attribute takes one location per column */
+         for(GLuint unColumn = 0; unColumn < 4; unColumn++) {
+            glVertexAttribPointer(m_nTransformAttribute + unColumn, 4, GL_FLOAT, GL_FALSE, sizeof(SInstance),
+               reinterpret_cast<const void*>(unOffset + offsetof(SInstance, Transform) +
+                                             unColumn * 4 * sizeof(GLfloat)));
+         }
+         glVertexAttribPointer(m_nRadiusScalesAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(SInstance),
+            reinterpret_cast<const void*>(unOffset + offsetof(SInstance, RadiusScales)));
+         glVertexAttribPointer(m_nColorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SInstance),
+            reinterpret_cast<const void*>(unOffset + offsetof(SInstance, Color)));
+         m_fnDrawArraysInstanced(GL_TRIANGLES,
+                                 m_pnFirstVertex[unShape],
+                                 m_pnVertexCount[unShape],
+                                 vecInstances.size());
+         unOffset += vecInstances.size() * sizeof(SInstance);
+         /* keep the memory for the next frame */
+         vecInstances.clear();
+      }
+      /* restore the state expected by the fixed-function drawing of ARGoS */
+      for(GLuint un_attribute : punInstanceAttributes) {
+         m_fnVertexAttribDivisor(un_attribute, 0);
+         glDisableVertexAttribArray(un_attribute);
+      }
+      glDisableVertexAttribArray(m_nVertexAttribute);
+      m_cInstanceBuffer.release();
+      m_cProgram.release();
+      glDisable(GL_BLEND);
+      glEnable(GL_LIGHTING);
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLBatchRenderer::MakeTransform(GLfloat* pf_matrix,
+                                                const CVector3& c_translation,
+                                                const CQuaternion& c_rotation,
+                                                const CVector3& c_scale) {
+      const Real fW = c_rotation.GetW();
+      const Real fX = c_rotation.GetX();
+      const Real fY = c_rotation.GetY();
+      const Real fZ = c_rotation.GetZ();
+      /* the columns of the rotation matrix, each scaled by its axis */
+      pf_matrix[0]  = (1.0 - 2.0 * (fY * fY + fZ * fZ)) * c_scale.GetX();
+      pf_matrix[1]  = (2.0 * (fX * fY + fW * fZ)) * c_scale.GetX();
+      pf_matrix[2]  = (2.0 * (fX * fZ - fW * fY)) * c_scale.GetX();
+      pf_matrix[3]  = 0.0f;
+      pf_matrix[4]  = (2.0 * (fX * fY - fW * fZ)) * c_scale.GetY();
+      pf_matrix[5]  = (1.0 - 2.0 * (fX * fX + fZ * fZ)) * c_scale.GetY();
+      pf_matrix[6]  = (2.0 * (fY * fZ + fW * fX)) * c_scale.GetY();
+      pf_matrix[7]  = 0.0f;
+      pf_matrix[8]  = (2.0 * (fX * fZ + fW * fY)) * c_scale.GetZ();
+      pf_matrix[9]  = (2.0 * (fY * fZ - fW * fX)) * c_scale.GetZ();
+      pf_matrix[10] = (1.0 - 2.0 * (fX * fX + fY * fY)) * c_scale.GetZ();
+      pf_matrix[11] = 0.0f;
+      pf_matrix[12] = c_translation.GetX();
+      pf_matrix[13] = c_translation.GetY();
+      pf_matrix[14] = c_translation.GetZ();
+      pf_matrix[15] = 1.0f;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLBatchRenderer::Multiply(GLfloat* pf_result,
+                                           const GLfloat* pf_lhs,
+                                           const GLfloat* pf_rhs) {
+      for(UInt32 unColumn = 0; unColumn < 4; unColumn++) {
+         for(UInt32 unRow = 0; unRow < 4; unRow++) {
+            pf_result[unColumn * 4 + unRow] =
+               pf_lhs[unRow]      * pf_rhs[unColumn * 4] +
+               pf_lhs[4 + unRow]  * pf_rhs[unColumn * 4 + 1] +
+               pf_lhs[8 + unRow]  * pf_rhs[unColumn * 4 + 2] +
+               pf_lhs[12 + unRow] * pf_rhs[unColumn * 4 + 3];
+         }
+      }
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLBatchRenderer::AddTriangle(const GLfloat (&pf_a)[4],
+                                              const GLfloat (&pf_b)[4],
+                                              const GLfloat (&pf_c)[4]) {
+      m_vecMesh.insert(std::end(m_vecMesh), std::begin(pf_a), std::end(pf_a));
+      m_vecMesh.insert(std::end(m_vecMesh), std::begin(pf_b), std::end(pf_b));
+      m_vecMesh.insert(std::end(m_vecMesh), std::begin(pf_c), std::end(pf_c));
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLBatchRenderer::MakeCylinder() {
+      /* same as the display list: radius 0.5, from z = 0 to z = 1 */
+      const UInt32 unShape = static_cast<UInt32>(EShape::CYLINDER);
+      m_pnFirstVertex[unShape] = m_vecMesh.size() / 4;
+      for(UInt32 unVertex = 0; unVertex < GL_NUMBER_VERTICES; unVertex++) {
+         const Real fAngle = CRadians::TWO_PI.GetValue() * unVertex / GL_NUMBER_VERTICES;
+         const Real fNextAngle = CRadians::TWO_PI.GetValue() * (unVertex + 1) / GL_NUMBER_VERTICES;
+         const GLfloat fX = 0.5 * std::cos(fAngle), fY = 0.5 * std::sin(fAngle);
+         const GLfloat fNextX = 0.5 * std::cos(fNextAngle), fNextY = 0.5 * std::sin(fNextAngle);
+         /* side surface */
+         AddTriangle({fX, fY, 0.0f, 0.0f}, {fNextX, fNextY, 0.0f, 0.0f}, {fNextX, fNextY, 1.0f, 0.0f});
+         AddTriangle({fX, fY, 0.0f, 0.0f}, {fNextX, fNextY, 1.0f, 0.0f}, {fX, fY, 1.0f, 0.0f});
+         /* top and bottom disks */
+         AddTriangle({0.0f, 0.0f, 1.0f, 0.0f}, {fX, fY, 1.0f, 0.0f}, {fNextX, fNextY, 1.0f, 0.0f});
+         AddTriangle({0.0f, 0.0f, 0.0f, 0.0f}, {fNextX, fNextY, 0.0f, 0.0f}, {fX, fY, 0.0f, 0.0f});
+      }
+      m_pnVertexCount[unShape] = m_vecMesh.size() / 4 - m_pnFirstVertex[unShape];
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLBatchRenderer::MakeCone() {
+      /* same as the display list: the tip at the origin, the base of radius 0.5 at z = -1 */
+      const UInt32 unShape = static_cast<UInt32>(EShape::CONE);
+      m_pnFirstVertex[unShape] = m_vecMesh.size() / 4;
+      for(UInt32 unVertex = 0; unVertex < GL_NUMBER_VERTICES; unVertex++) {
+         const Real fAngle = CRadians::TWO_PI.GetValue() * unVertex / GL_NUMBER_VERTICES;
+         const Real fNextAngle = CRadians::TWO_PI.GetValue() * (unVertex + 1) / GL_NUMBER_VERTICES;
+         const GLfloat fX = 0.5 * std::cos(fAngle), fY = 0.5 * std::sin(fAngle);
+         const GLfloat fNextX = 0.5 * std::cos(fNextAngle), fNextY = 0.5 * std::sin(fNextAngle);
+         /* cone surface */
+         AddTriangle({fX, fY, -1.0f, 0.0f}, {fNextX, fNextY, -1.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f});
+         /* bottom disk */
+         AddTriangle({0.0f, 0.0f, -1.0f, 0.0f}, {fNextX, fNextY, -1.0f, 0.0f}, {fX, fY, -1.0f, 0.0f});
+      }
+      m_pnVertexCount[unShape] = m_vecMesh.size() / 4 - m_pnFirstVertex[unShape];
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLBatchRenderer::MakeRing() {
+      /* the inner (w = 0) and the outer (w = 1) walls of radius 0.5 from z = 0 to z = 1, both
+         facing in and out like the display list, and the top between them */
+      const UInt32 unShape = static_cast<UInt32>(EShape::RING);
+      m_pnFirstVertex[unShape] = m_vecMesh.size() / 4;
+      for(UInt32 unVertex = 0; unVertex < GL_NUMBER_VERTICES; unVertex++) {
+         const Real fAngle = CRadians::TWO_PI.GetValue() * unVertex / GL_NUMBER_VERTICES;
+         const Real fNextAngle = CRadians::TWO_PI.GetValue() * (unVertex + 1) / GL_NUMBER_VERTICES;
+         const GLfloat fX = 0.5 * std::cos(fAngle), fY = 0.5 * std::sin(fAngle);
+         const GLfloat fNextX = 0.5 * std::cos(fNextAngle), fNextY = 0.5 * std::sin(fNextAngle);
+         for(GLfloat f_wall : {0.0f, 1.0f}) {
+            AddTriangle({fX, fY, 0.0f, f_wall}, {fNextX, fNextY, 0.0f, f_wall}, {fNextX, fNextY, 1.0f, f_wall});
+            AddTriangle({fX, fY, 0.0f, f_wall}, {fNextX, fNextY, 1.0f, f_wall}, {fX, fY, 1.0f, f_wall});
+            AddTriangle({fX, fY, 0.0f, f_wall}, {fNextX, fNextY, 1.0f, f_wall}, {fNextX, fNextY, 0.0f, f_wall});
+            AddTriangle({fX, fY, 0.0f, f_wall}, {fX, fY, 1.0f, f_wall}, {fNextX, fNextY, 1.0f, f_wall});
+         }
+         AddTriangle({fX, fY, 1.0f, 0.0f}, {fX, fY, 1.0f, 1.0f}, {fNextX, fNextY, 1.0f, 1.0f});
+         AddTriangle({fX, fY, 1.0f, 0.0f}, {fNextX, fNextY, 1.0f, 1.0f}, {fNextX, fNextY, 1.0f, 0.0f});
+      }
+      m_pnVertexCount[unShape] = m_vecMesh.size() / 4 - m_pnFirstVertex[unShape];
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+}
@@ -0,0 +1,109 @@
+#ifndef DI_QTOPENGL_BATCH_RENDERER_H
+#define DI_QTOPENGL_BATCH_RENDERER_H
+
+#include <argos3/core/utility/datatypes/color.h>
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <argos3/core/utility/math/quaternion.h>
+#include <argos3/core/utility/math/vector3.h>
+
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+
+#include <vector>
+
+namespace argos {
+
+   /*
+    * Collects the annotation primitives of a frame and draws all instances of a shape with a
+    * single instanced call. The shapes are the unit cylinder, cone and ring of the display lists
+    * of the user functions. The transform and the color of each instance are streamed into a
+    * vertex buffer once per frame. Instancing requires glDrawArraysInstanced and
+    * glVertexAttribDivisor (OpenGL 3.3 or ARB_instanced_arrays), if they are missing or the
+    * shader does not compile, IsSupported() returns false and the caller keeps drawing with the
+    * display lists.
+    */
+   class CDIQtOpenGLBatchRenderer : protected QOpenGLFunctions {
+
+   public:
+
+      enum class EShape : UInt8 {
+         CYLINDER,
+         CONE,
+         /* the walls and the top of a ring, the outer wall is scaled separately */
+         RING,
+      };
+
+   public:
+
+      /* initializes the renderer on the first call, requires a current OpenGL context */
+      bool IsSupported();
+
+      /* adds an instance of a shape, the radii of the inner and the outer vertices of a ring are
+         scaled by f_inner_scale and f_outer_scale on top of pf_transform */
+      void Add(EShape e_shape,
+               const GLfloat* pf_transform,
+               const CColor& c_color,
+               GLfloat f_inner_scale = 1.0f,
+               GLfloat f_outer_scale = 1.0f);
+
+      /* draws and removes the instances that have been added since the last call */
+      void Flush();
+
+      /* writes the column-major matrix of a translation, a rotation and a scaling into pf_matrix */
+      static void MakeTransform(GLfloat* pf_matrix,
+                                const CVector3& c_translation,
+                                const CQuaternion& c_rotation,
+                                const CVector3& c_scale = CVector3(1.0, 1.0, 1.0));
+
+      /* writes pf_lhs * pf_rhs into pf_result, which must not alias the operands */
+      static void Multiply(GLfloat* pf_result, const GLfloat* pf_lhs, const GLfloat* pf_rhs);
+
+   private:
+
+      bool Init();
+
+      void MakeCylinder();
+      void MakeCone();
+      void MakeRing();
+
+      /* adds a triangle to the mesh, the fourth component selects the outer radius of a ring */
+      void AddTriangle(const GLfloat (&pf_a)[4], const GLfloat (&pf_b)[4], const GLfloat (&pf_c)[4]);
+
+   private:
+
+      static const UInt32 NUMBER_OF_SHAPES = 3;
+
+      struct SInstance {
+         GLfloat Transform[16];
+         GLfloat RadiusScales[2];
+         GLubyte Color[4];
+      };
+
+      bool m_bInitialized = false;
+      bool m_bSupported = false;
+
+      /* resolved from the context, since QOpenGLFunctions only covers OpenGL ES 2.0 */
+      void (QOPENGLF_APIENTRYP m_fnVertexAttribDivisor)(GLuint, GLuint) = nullptr;
+      void (QOPENGLF_APIENTRYP m_fnDrawArraysInstanced)(GLenum, GLint, GLsizei, GLsizei) = nullptr;
+
+      QOpenGLShaderProgram m_cProgram;
+      int m_nVertexAttribute = -1;
+      int m_nTransformAttribute = -1;
+      int m_nRadiusScalesAttribute = -1;
+      int m_nColorAttribute = -1;
+
+      /* the triangles of all shapes and the range of each shape */
+      std::vector<GLfloat> m_vecMesh;
+      GLint m_pnFirstVertex[NUMBER_OF_SHAPES] = {};
+      GLsizei m_pnVertexCount[NUMBER_OF_SHAPES] = {};
+      QOpenGLBuffer m_cMeshBuffer;
+
+      std::vector<SInstance> m_pvecInstances[NUMBER_OF_SHAPES];
+      QOpenGLBuffer m_cInstanceBuffer;
+
+   };
+
+}
+
+#endif
@@ -8,11 +8,23 @@
 #include <argos3/plugins/simulator/visualizations/qt-opengl/qtopengl_main_window.h>
 #include <argos3/plugins/simulator/entities/debug_entity.h>
 
+#include <QApplication>
 #include <QWheelEvent>
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+
+#include <locale.h>
+
 #define GL_NUMBER_VERTICES 36u
 #define BLOCK_SIDE_LENGTH 0.055
 #define DELTA_Z 0.0005
+#define ARROW_THICKNESS 0.015625
+#define ARROW_HEAD 0.03125
+#define RING_HEIGHT 0.015625
+#define RING_THICKNESS 0.015625
 
 namespace argos {
 
@@ -32,6 +44,17 @@ namespace argos {
       if(pcEntity == nullptr) {
          return QObject::eventFilter(pc_object, pc_event);
       }
+      /* the robots of a group are rotated around the selected robot */
+      CEmbodiedEntity* pcEmbodiedEntity = CDIQtOpenGLUserFunctions::GetRobotEmbodiedEntity(*pcEntity);
+      if(pcEmbodiedEntity != nullptr && m_pcUserFunctions->IsGroupMember(*pcEntity)) {
+         CDegrees cDegrees(pcWheelEvent->angleDelta().y() / 8);
+         CQuaternion cRotation(ToRadians(cDegrees), CVector3::Z);
+         const SAnchor& sOriginAnchor = pcEmbodiedEntity->GetOriginAnchor();
+         if(m_pcUserFunctions->MoveGroup(sOriginAnchor.Position, cRotation, CVector3::ZERO)) {
+            m_pcUserFunctions->GetQTOpenGLWidget().update();
+         }
+         return true;
+      }
       CBuilderBotEntity* pcBuilderBotEntity = dynamic_cast<CBuilderBotEntity*>(pcEntity);
       if(pcBuilderBotEntity == nullptr) {
          return QObject::eventFilter(pc_object, pc_event);
@@ -42,54 +65,50 @@ namespace argos {
       /* get the target position of a block */
       CVector3 cTargetBlockPos(sBuilderBotEndEffectorAnchor.Position);
       cTargetBlockPos -= (CVector3::Z * BLOCK_SIDE_LENGTH);
-      try {
-         std::map<std::string, CAny>& mapBlockEntities =
-            CSimulator::GetInstance().GetSpace().GetEntitiesByType("block");
-         for(const std::pair<const std::string, CAny>& c_block : mapBlockEntities) {
-            CEmbodiedEntity& cBlockEmbodiedEntity =
-               any_cast<CBlockEntity*>(c_block.second)->GetEmbodiedEntity();
-            const SAnchor& sBlockOriginAnchor = cBlockEmbodiedEntity.GetOriginAnchor();
-            if(Distance(cTargetBlockPos, sBlockOriginAnchor.Position) < 0.005) {
-               /* we have found our block, save its position and move it to just below the floor */
-               const CVector3 cBlockInitPosition(sBlockOriginAnchor.Position);
-               const CQuaternion cBlockInitOrientation(sBlockOriginAnchor.Orientation);
-               const CVector3 cBuilderBotInitPosition(sBuilderBotOriginAnchor.Position);
-               const CQuaternion cBuilderBotInitOrientation(sBuilderBotOriginAnchor.Orientation);
-               // step one: move the block to a temporary position */
-               CVector3 cBlockTempPosition(cBlockInitPosition);
-               cBlockTempPosition.SetZ(-2.0 * BLOCK_SIDE_LENGTH);
-               if(cBlockEmbodiedEntity.MoveTo(cBlockTempPosition,
-                                              sBlockOriginAnchor.Orientation)) {
-                  CDegrees cDegrees(pcWheelEvent->angleDelta().y() / 8);
-                  CQuaternion cRotation(ToRadians(cDegrees), CVector3::Z);
-                  // step two: rotate the builderbot
-                  if(cBuilderBotEmbodiedEntity.MoveTo(cBuilderBotInitPosition,
-                                                      cBuilderBotInitOrientation * cRotation)) {
-                     // step three: rotate and translate the block
-                     CVector3 cBlockNewPosition(cBlockInitPosition - cBuilderBotInitPosition);
-                     cBlockNewPosition.Rotate(cRotation);
-                     cBlockNewPosition += cBuilderBotInitPosition;
-                     Real fBlockEndEffectorDistance =
-                        Distance(cBlockNewPosition, sBuilderBotEndEffectorAnchor.Position);
-                     if(fBlockEndEffectorDistance < BLOCK_SIDE_LENGTH + DELTA_Z) {
-                        cBlockNewPosition -= (CVector3::Z * DELTA_Z);
-                     }
-                     CQuaternion cBlockNewOrientation(cBlockInitOrientation * cRotation);
-                     if(cBlockEmbodiedEntity.MoveTo(cBlockNewPosition,
-                                                    cBlockNewOrientation)) {
-                        m_pcUserFunctions->GetQTOpenGLWidget().update();
-                        return true;
-                     }
-                  }
-               }
-               cBuilderBotEmbodiedEntity.MoveTo(cBuilderBotInitPosition, cBuilderBotInitOrientation);
-               cBlockEmbodiedEntity.MoveTo(cBlockInitPosition, cBlockInitOrientation);
+      UInt32 unBlock = m_pcUserFunctions->FindBlock(cTargetBlockPos, 0.005);
+      if(unBlock == CDISRoCSSpatialHash::NONE) {
+         return QObject::eventFilter(pc_object, pc_event);
+      }
+      CEmbodiedEntity& cBlockEmbodiedEntity =
+         m_pcUserFunctions->GetBlock(unBlock).GetEmbodiedEntity();
+      const SAnchor& sBlockOriginAnchor = cBlockEmbodiedEntity.GetOriginAnchor();
+      /* we have found our block, save its position and move it to just below the floor */
+      const CVector3 cBlockInitPosition(sBlockOriginAnchor.Position);
+      const CQuaternion cBlockInitOrientation(sBlockOriginAnchor.Orientation);
+      const CVector3 cBuilderBotInitPosition(sBuilderBotOriginAnchor.Position);
+      const CQuaternion cBuilderBotInitOrientation(sBuilderBotOriginAnchor.Orientation);
+      // step one: move the block to a temporary position */
+      CVector3 cBlockTempPosition(cBlockInitPosition);
+      cBlockTempPosition.SetZ(-2.0 * BLOCK_SIDE_LENGTH);
+      if(cBlockEmbodiedEntity.MoveTo(cBlockTempPosition,
+                                     sBlockOriginAnchor.Orientation)) {
+         CDegrees cDegrees(pcWheelEvent->angleDelta().y() / 8);
+         CQuaternion cRotation(ToRadians(cDegrees), CVector3::Z);
+         // step two: rotate the builderbot
+         if(cBuilderBotEmbodiedEntity.MoveTo(cBuilderBotInitPosition,
+                                             cBuilderBotInitOrientation * cRotation)) {
+            // step three: rotate and translate the block
+            CVector3 cBlockNewPosition(cBlockInitPosition - cBuilderBotInitPosition);
+            cBlockNewPosition.Rotate(cRotation);
+            cBlockNewPosition += cBuilderBotInitPosition;
+            Real fBlockEndEffectorDistance =
+               Distance(cBlockNewPosition, sBuilderBotEndEffectorAnchor.Position);
+            if(fBlockEndEffectorDistance < BLOCK_SIDE_LENGTH + DELTA_Z) {
+               cBlockNewPosition -= (CVector3::Z * DELTA_Z);
+            }
+            CQuaternion cBlockNewOrientation(cBlockInitOrientation * cRotation);
+            if(cBlockEmbodiedEntity.MoveTo(cBlockNewPosition,
+                                           cBlockNewOrientation)) {
+               m_pcUserFunctions->BlockMoved(unBlock);
+               m_pcUserFunctions->GetQTOpenGLWidget().update();
                return true;
             }
          }
       }
-      catch(CARGoSException& ex) {}
-      return QObject::eventFilter(pc_object, pc_event);
+      cBuilderBotEmbodiedEntity.MoveTo(cBuilderBotInitPosition, cBuilderBotInitOrientation);
+      cBlockEmbodiedEntity.MoveTo(cBlockInitPosition, cBlockInitOrientation);
+      m_pcUserFunctions->BlockMoved(unBlock);
+      return true;
    }
 
    /********************************************************************************/
@@ -110,10 +129,15 @@ namespace argos {
    /********************************************************************************/
 
    void CDIQtOpenGLUserFunctions::Init(TConfigurationNode& t_tree) {
+      GetNodeAttributeOrDefault(t_tree, "instancing", m_bInstancing, m_bInstancing);
       /* install the mouse wheel event handler */
       m_pcMouseWheelEventHandler =
          new CDIQtOpenGLUserFunctionsMouseWheelEventHandler(&GetQTOpenGLWidget(), this);
       GetQTOpenGLWidget().installEventFilter(m_pcMouseWheelEventHandler);
+      /* index the blocks in cells of the size of a block, covering the arena */
+      CSpace& cSpace = CSimulator::GetInstance().GetSpace();
+      m_cBlockIndex.Init(cSpace.GetArenaCenter(), cSpace.GetArenaSize(), BLOCK_SIDE_LENGTH);
+      UpdateBlockIndex();
    }
 
    /********************************************************************************/
@@ -122,6 +146,20 @@ namespace argos {
    void CDIQtOpenGLUserFunctions::EntityMoved(CEntity& c_entity,
                                               const CVector3& c_old_pos,
                                               const CVector3& c_new_pos) {
+      /* was a robot of a group moved? */
+      if(IsGroupMember(c_entity)) {
+         /* move the robot back, so that it is moved together with the rest of the group */
+         CEmbodiedEntity* pcEmbodiedEntity = GetRobotEmbodiedEntity(c_entity);
+         const CQuaternion cOrientation(pcEmbodiedEntity->GetOriginAnchor().Orientation);
+         if(pcEmbodiedEntity->MoveTo(c_old_pos, cOrientation)) {
+            MoveGroup(c_old_pos, CQuaternion(), c_new_pos - c_old_pos);
+         }
+         else {
+            /* otherwise, move the rest of the group after the robot */
+            MoveGroup(c_old_pos, CQuaternion(), c_new_pos - c_old_pos, pcEmbodiedEntity);
+         }
+         return;
+      }
       /* was a builderbot moved? */
       CBuilderBotEntity* pcBuilderBot = dynamic_cast<CBuilderBotEntity*>(&c_entity);
       if(pcBuilderBot == nullptr) {
@@ -135,25 +173,294 @@ namespace argos {
       CVector3 cOldEndEffectorPos(sEndEffectorAnchor.Position - cDeltaPos);
       /* get the potential position of a block */
       CVector3 cBlockTestPos(cOldEndEffectorPos - CVector3::Z * BLOCK_SIDE_LENGTH);
-      try {
-         std::map<std::string, CAny>& mapBlockEntities =
-            CSimulator::GetInstance().GetSpace().GetEntitiesByType("block");
-         for(const std::pair<const std::string, CAny>& c_block : mapBlockEntities) {
-            CEmbodiedEntity& cEmbodiedEntity =
-               any_cast<CBlockEntity*>(c_block.second)->GetEmbodiedEntity();
-            const SAnchor& sBlockAnchor = cEmbodiedEntity.GetOriginAnchor();
-            /* if the origin of a block is within 0.005 meters of where
-               we expected to find a block, move it */
-            if(Distance(cBlockTestPos, sBlockAnchor.Position) < 0.005) {
-               /* here, we drop the blocks position by 0.0005 meters to compensate for
-                  inaccuracies in the physics engine */
-               cEmbodiedEntity.MoveTo(sBlockAnchor.Position + cDeltaPos - (CVector3::Z * 0.0005),
-                                      sBlockAnchor.Orientation);
-               return;
+      /* if the origin of a block is within 0.005 meters of where
+         we expected to find a block, move it */
+      UInt32 unBlock = FindBlock(cBlockTestPos, 0.005);
+      if(unBlock != CDISRoCSSpatialHash::NONE) {
+         CEmbodiedEntity& cEmbodiedEntity = m_vecBlocks[unBlock]->GetEmbodiedEntity();
+         const SAnchor& sBlockAnchor = cEmbodiedEntity.GetOriginAnchor();
+         /* here, we drop the blocks position by 0.0005 meters to compensate for
+            inaccuracies in the physics engine */
+         cEmbodiedEntity.MoveTo(sBlockAnchor.Position + cDeltaPos - (CVector3::Z * 0.0005),
+                                sBlockAnchor.Orientation);
+         BlockMoved(unBlock);
+      }
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::EntitySelected(CEntity& c_entity) {
+      CQTOpenGLUserFunctions::EntitySelected(c_entity);
+      std::vector<std::string>::iterator itMember =
+         std::find(std::begin(m_vecGroup), std::end(m_vecGroup), c_entity.GetId());
+      if(QApplication::keyboardModifiers() & Qt::ControlModifier) {
+         if(itMember != std::end(m_vecGroup)) {
+            m_vecGroup.erase(itMember);
+         }
+         else if(GetRobotEmbodiedEntity(c_entity) != nullptr) {
+            m_vecGroup.push_back(c_entity.GetId());
+         }
+      }
+      else if(itMember == std::end(m_vecGroup)) {
+         m_vecGroup.clear();
+      }
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   UInt32 CDIQtOpenGLUserFunctions::FindBlock(const CVector3& c_position, Real f_tolerance) {
+      /* blocks may have been added, removed or moved by the physics engines since the index was
+         synchronized, the number of blocks alone does not tell if the pointers are still valid */
+      if(CSimulator::GetInstance().GetSpace().GetSimulationClock() != m_unBlockIndexClock) {
+         UpdateBlockIndex();
+      }
+      UInt32 unFoundBlock = CDISRoCSSpatialHash::NONE;
+      m_cBlockIndex.ForEachInSphere(c_position, f_tolerance, [&] (UInt32 un_block) {
+         const SAnchor& sBlockAnchor = m_vecBlocks[un_block]->GetEmbodiedEntity().GetOriginAnchor();
+         if(Distance(c_position, sBlockAnchor.Position) < f_tolerance) {
+            unFoundBlock = un_block;
+            return true;
+         }
+         return false;
+      });
+      return unFoundBlock;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::BlockMoved(UInt32 un_block) {
+      m_cBlockIndex.Update(un_block,
+                           m_vecBlocks[un_block]->GetEmbodiedEntity().GetOriginAnchor().Position);
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   CEmbodiedEntity* CDIQtOpenGLUserFunctions::GetRobotEmbodiedEntity(CEntity& c_entity) {
+      if(CBuilderBotEntity* pcBuilderBot = dynamic_cast<CBuilderBotEntity*>(&c_entity)) {
+         return &pcBuilderBot->GetEmbodiedEntity();
+      }
+      if(CPiPuckEntity* pcPiPuck = dynamic_cast<CPiPuckEntity*>(&c_entity)) {
+         return &pcPiPuck->GetEmbodiedEntity();
+      }
+      if(CDroneEntity* pcDrone = dynamic_cast<CDroneEntity*>(&c_entity)) {
+         return &pcDrone->GetEmbodiedEntity();
+      }
+      return nullptr;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   bool CDIQtOpenGLUserFunctions::IsGroupMember(const CEntity& c_entity) const {
+      return m_vecGroup.size() > 1 &&
+         std::find(std::begin(m_vecGroup), std::end(m_vecGroup), c_entity.GetId()) !=
+         std::end(m_vecGroup);
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::PruneGroup() {
+      CEntity::TMap& mapEntities = CSimulator::GetInstance().GetSpace().GetEntityMapPerId();
+      m_vecGroup.erase(std::remove_if(std::begin(m_vecGroup), std::end(m_vecGroup),
+                                      [&mapEntities] (const std::string& str_id) {
+         CEntity::TMap::iterator itEntity = mapEntities.find(str_id);
+         return itEntity != std::end(mapEntities) &&
+                GetRobotEmbodiedEntity(*itEntity->second) == nullptr;
+      }), std::end(m_vecGroup));
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   bool CDIQtOpenGLUserFunctions::MoveGroup(const CVector3& c_pivot,
+                                            const CQuaternion& c_rotation,
+                                            const CVector3& c_translation,
+                                            CEmbodiedEntity* pc_moved) {
+      /* collect the robots of the group and the blocks that the builderbots carry */
+      PruneGroup();
+      CEntity::TMap& mapEntities = CSimulator::GetInstance().GetSpace().GetEntityMapPerId();
+      m_vecGroupMembers.clear();
+      for(const std::string& str_id : m_vecGroup) {
+         CEntity::TMap::iterator itEntity = mapEntities.find(str_id);
+         if(itEntity == std::end(mapEntities)) {
+            continue;
+         }
+         CEmbodiedEntity* pcEmbodiedEntity = GetRobotEmbodiedEntity(*itEntity->second);
+         const SAnchor& sOriginAnchor = pcEmbodiedEntity->GetOriginAnchor();
+         /* the transform applies to the pose of a moved robot before it was moved */
+         CVector3 cOffset(pcEmbodiedEntity == pc_moved ? c_translation : CVector3::ZERO);
+         m_vecGroupMembers.push_back(SGroupMember {
+            pcEmbodiedEntity, CDISRoCSSpatialHash::NONE,
+            sOriginAnchor.Position, sOriginAnchor.Orientation,
+            sOriginAnchor.Position - cOffset, sOriginAnchor.Orientation,
+            sOriginAnchor.Position, sOriginAnchor.Orientation
+         });
+         if(dynamic_cast<CBuilderBotEntity*>(itEntity->second) != nullptr) {
+            const SAnchor& sEndEffectorAnchor = pcEmbodiedEntity->GetAnchor("end_effector");
+            UInt32 unBlock = FindBlock(sEndEffectorAnchor.Position - cOffset -
+                                       CVector3::Z * BLOCK_SIDE_LENGTH, 0.005);
+            if(unBlock != CDISRoCSSpatialHash::NONE) {
+               CEmbodiedEntity& cBlockEmbodiedEntity = m_vecBlocks[unBlock]->GetEmbodiedEntity();
+               const SAnchor& sBlockAnchor = cBlockEmbodiedEntity.GetOriginAnchor();
+               m_vecGroupMembers.push_back(SGroupMember {
+                  &cBlockEmbodiedEntity, unBlock,
+                  sBlockAnchor.Position, sBlockAnchor.Orientation,
+                  sBlockAnchor.Position, sBlockAnchor.Orientation,
+                  sBlockAnchor.Position, sBlockAnchor.Orientation
+               });
             }
          }
       }
-      catch(CARGoSException& ex) {}
+      if(m_vecGroupMembers.empty()) {
+         return false;
+      }
+      /* compute the targets of the rigid transform */
+      for(SGroupMember& s_member : m_vecGroupMembers) {
+         CVector3 cPosition(s_member.InitPosition - c_pivot);
+         cPosition.Rotate(c_rotation);
+         s_member.TargetPosition = cPosition + c_pivot + c_translation;
+         s_member.TargetOrientation = c_rotation * s_member.InitOrientation;
+         if(s_member.Block != CDISRoCSSpatialHash::NONE) {
+            /* here, we drop the blocks by DELTA_Z to compensate for inaccuracies in the
+               physics engine */
+            s_member.TargetPosition -= CVector3::Z * DELTA_Z;
+         }
+      }
+      /* test the targets of all blocks against the other blocks in the index before any entity
+         is moved, two blocks overlap if the spheres inscribed in them overlap */
+      auto fnIsGroupBlock = [this] (UInt32 un_block) {
+         return std::any_of(std::begin(m_vecGroupMembers),
+                            std::end(m_vecGroupMembers),
+                            [un_block] (const SGroupMember& s_member) {
+                               return s_member.Block == un_block;
+                            });
+      };
+      bool bRejected = false;
+      for(const SGroupMember& s_member : m_vecGroupMembers) {
+         if(s_member.Block == CDISRoCSSpatialHash::NONE) {
+            continue;
+         }
+         auto fnIsOverlapping = [&] (UInt32 un_block) {
+            const SAnchor& sBlockAnchor =
+               m_vecBlocks[un_block]->GetEmbodiedEntity().GetOriginAnchor();
+            return !fnIsGroupBlock(un_block) &&
+               Distance(s_member.TargetPosition, sBlockAnchor.Position) < BLOCK_SIDE_LENGTH - DELTA_Z;
+         };
+         if(m_cBlockIndex.ForEachInSphere(s_member.TargetPosition, BLOCK_SIDE_LENGTH, fnIsOverlapping)) {
+            bRejected = true;
+            break;
+         }
+      }
+      if(bRejected) {
+         if(pc_moved == nullptr) {
+            return false;
+         }
+         /* move the robot that has already been moved back together with the rest of the group */
+         for(SGroupMember& s_member : m_vecGroupMembers) {
+            s_member.TargetPosition = s_member.InitPosition;
+            s_member.TargetOrientation = s_member.InitOrientation;
+         }
+      }
+      /* move the group below the floor first, so that its entities can neither collide with the
+         other entities nor with each other while they are moved to their targets */
+      Real fTop = 0.0;
+      for(const SGroupMember& s_member : m_vecGroupMembers) {
+         fTop = std::max(fTop, s_member.EmbodiedEntity->GetBoundingBox().MaxCorner.GetZ());
+      }
+      const CVector3 cBelowFloor(CVector3::Z * -(fTop + BLOCK_SIDE_LENGTH));
+      UInt32 unBelowFloor = 0;
+      UInt32 unAtTarget = 0;
+      for(; unBelowFloor < m_vecGroupMembers.size(); unBelowFloor++) {
+         const SGroupMember& sMember = m_vecGroupMembers[unBelowFloor];
+         if(!sMember.EmbodiedEntity->MoveTo(sMember.InitPosition + cBelowFloor,
+                                            sMember.InitOrientation)) {
+            break;
+         }
+      }
+      if(unBelowFloor == m_vecGroupMembers.size()) {
+         for(; unAtTarget < m_vecGroupMembers.size(); unAtTarget++) {
+            const SGroupMember& sMember = m_vecGroupMembers[unAtTarget];
+            if(!sMember.EmbodiedEntity->MoveTo(sMember.TargetPosition,
+                                               sMember.TargetOrientation)) {
+               break;
+            }
+         }
+      }
+      if(unAtTarget != m_vecGroupMembers.size()) {
+         /* roll back, the entities at their targets are moved below the floor again before all
+            entities are moved back to where they were */
+         for(UInt32 unMember = 0; unMember < unAtTarget; unMember++) {
+            const SGroupMember& sMember = m_vecGroupMembers[unMember];
+            sMember.EmbodiedEntity->MoveTo(sMember.InitPosition + cBelowFloor,
+                                           sMember.InitOrientation);
+         }
+         for(UInt32 unMember = 0; unMember < m_vecGroupMembers.size(); unMember++) {
+            const SGroupMember& sMember = m_vecGroupMembers[unMember];
+            /* the entities that could not be moved below the floor are still at their initial
+               pose, except for a robot that has already been moved, which is moved back to its
+               initial pose if possible */
+            if(unMember >= unBelowFloor && sMember.EmbodiedEntity != pc_moved) {
+               continue;
+            }
+            if(!sMember.EmbodiedEntity->MoveTo(sMember.InitPosition,
+                                               sMember.InitOrientation)) {
+               sMember.EmbodiedEntity->MoveTo(sMember.StartPosition,
+                                              sMember.StartOrientation);
+            }
+         }
+      }
+      for(const SGroupMember& s_member : m_vecGroupMembers) {
+         if(s_member.Block != CDISRoCSSpatialHash::NONE) {
+            BlockMoved(s_member.Block);
+         }
+      }
+      return !bRejected && unAtTarget == m_vecGroupMembers.size();
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::UpdateBlockIndex() {
+      CSpace& cSpace = CSimulator::GetInstance().GetSpace();
+      m_unBlockIndexClock = cSpace.GetSimulationClock();
+      CSpace::TMapPerTypePerId& mapEntities = cSpace.GetEntityMapPerTypePerId();
+      CSpace::TMapPerTypePerId::iterator itBlocks = mapEntities.find("block");
+      if(itBlocks == std::end(mapEntities)) {
+         m_vecBlocks.clear();
+         m_cBlockIndex.Clear(0);
+         return;
+      }
+      /* only rebuild the index if the blocks have changed, otherwise move the blocks into
+         their current cells */
+      bool bRebuild = (itBlocks->second.size() != m_vecBlocks.size());
+      UInt32 unBlock = 0;
+      for(CSpace::TMapPerType::iterator itBlock = std::begin(itBlocks->second);
+          !bRebuild && itBlock != std::end(itBlocks->second);
+          ++itBlock, ++unBlock) {
+         CBlockEntity* pcBlock = any_cast<CBlockEntity*>(itBlock->second);
+         if(m_vecBlocks[unBlock] == pcBlock) {
+            m_cBlockIndex.Update(unBlock, pcBlock->GetEmbodiedEntity().GetOriginAnchor().Position);
+         }
+         else {
+            bRebuild = true;
+         }
+      }
+      if(bRebuild) {
+         m_vecBlocks.clear();
+         for(const std::pair<const std::string, CAny>& c_block : itBlocks->second) {
+            m_vecBlocks.push_back(any_cast<CBlockEntity*>(c_block.second));
+         }
+         m_cBlockIndex.Clear(m_vecBlocks.size());
+         for(unBlock = 0; unBlock < m_vecBlocks.size(); unBlock++) {
+            m_cBlockIndex.Insert(unBlock,
+                                 m_vecBlocks[unBlock]->GetEmbodiedEntity().GetOriginAnchor().Position);
+         }
+      }
    }
 
    /********************************************************************************/
@@ -161,42 +468,43 @@ namespace argos {
 
    void CDIQtOpenGLUserFunctions::Annotate(CDebugEntity& c_debug_entity,
                                             const SAnchor& s_anchor) {
+      /* only parse the buffer again if its content has changed since the last frame */
+      const std::string& strBuffer = c_debug_entity.GetBuffer("draw");
+      SAnnotationCache& sCache = m_mapAnnotationCaches[&c_debug_entity];
+      sCache.Frame = m_unFrame;
+      size_t unHash = std::hash<std::string>()(strBuffer);
+      if(sCache.Length != strBuffer.size() || sCache.Hash != unHash) {
+         ParseAnnotations(strBuffer, sCache.Annotations);
+         sCache.Hash = unHash;
+         sCache.Length = strBuffer.size();
+      }
+      if(sCache.Annotations.empty()) {
+         return;
+      }
+      const GLfloat* pfAnchor = GetAnchorTransform(sCache, s_anchor);
+      /* batch the annotations, they are drawn in DrawInWorld */
+      if(m_bInstancing && m_cBatchRenderer.IsSupported()) {
+         for(const SAnnotation& s_annotation : sCache.Annotations) {
+            AddAnnotation(pfAnchor, s_annotation);
+         }
+         return;
+      }
+      /* otherwise, draw them with the display lists */
       glDisable(GL_LIGHTING);
       glEnable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-      const CVector3& cPosition = s_anchor.Position;
-      const CQuaternion& cOrientation = s_anchor.Orientation;
-      CRadians cZAngle, cYAngle, cXAngle;
-      cOrientation.ToEulerAngles(cZAngle, cYAngle, cXAngle);
       glPushMatrix();
-      glTranslatef(cPosition.GetX(), cPosition.GetY(), cPosition.GetZ());
-      glRotatef(ToDegrees(cXAngle).GetValue(), 1.0f, 0.0f, 0.0f);
-      glRotatef(ToDegrees(cYAngle).GetValue(), 0.0f, 1.0f, 0.0f);
-      glRotatef(ToDegrees(cZAngle).GetValue(), 0.0f, 0.0f, 1.0f);
-      std::istringstream issInstructions, issArgument;
-      //issInstructions.str(c_debug_entity.GetBuffer("draw"));
-      issInstructions.str("");
-      for(std::string strInstruction; std::getline(issInstructions, strInstruction); ) {
-         std::vector<std::string> vecArguments;
-         Tokenize(strInstruction, vecArguments, "()");
-         if(vecArguments.size() == 4 && vecArguments[0] == "arrow") {
-            CColor cColor;
-            CVector3 cTo, cFrom;
-            std::istringstream(vecArguments[1]) >> cColor;
-            std::istringstream(vecArguments[2]) >> cFrom;
-            std::istringstream(vecArguments[3]) >> cTo;
-            glColor4ub(cColor.GetRed(), cColor.GetGreen(), cColor.GetBlue(), 128u);
-            DrawArrow3(cFrom, cTo);
-         }
-         else if(vecArguments.size() == 4 && vecArguments[0] == "ring") {
-            CColor cColor;
-            CVector3 cCenter;
-            Real fRadius;
-            std::istringstream(vecArguments[1]) >> cColor;
-            std::istringstream(vecArguments[2]) >> cCenter;
-            std::istringstream(vecArguments[3]) >> fRadius;
-            glColor4ub(cColor.GetRed(), cColor.GetGreen(), cColor.GetBlue(), 128u);
-            DrawRing3(cCenter, fRadius);
+      glMultMatrixf(pfAnchor);
+      for(const SAnnotation& s_annotation : sCache.Annotations) {
+         const CColor& cColor = s_annotation.Color;
+         glColor4ub(cColor.GetRed(), cColor.GetGreen(), cColor.GetBlue(), 128u);
+         switch(s_annotation.Type) {
+            case SAnnotation::EType::ARROW:
+               DrawArrow3(s_annotation);
+               break;
+            case SAnnotation::EType::RING:
+               DrawRing3(s_annotation.From, s_annotation.Radius);
+               break;
          }
       }
       glPopMatrix();
@@ -207,10 +515,314 @@ namespace argos {
    /********************************************************************************/
    /********************************************************************************/
 
+   bool CDIQtOpenGLUserFunctions::SToken::operator==(const char* pch_string) const {
+      const char* pchCharacter = Begin;
+      for(; pchCharacter != End && *pch_string != '\0'; pchCharacter++, pch_string++) {
+         if(std::tolower(static_cast<unsigned char>(*pchCharacter)) != *pch_string) {
+            return false;
+         }
+      }
+      return pchCharacter == End && *pch_string == '\0';
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   UInt32 CDIQtOpenGLUserFunctions::TokenizeInstruction(const char* pch_begin,
+                                                        const char* pch_end,
+                                                        SToken* ps_tokens,
+                                                        UInt32 un_max_tokens) {
+      UInt32 unTokens = 0;
+      const char* pchToken = pch_begin;
+      for(const char* pchCharacter = pch_begin; pchCharacter <= pch_end; pchCharacter++) {
+         if(pchCharacter == pch_end || *pchCharacter == '(' || *pchCharacter == ')') {
+            if(pchCharacter != pchToken) {
+               if(unTokens < un_max_tokens) {
+                  ps_tokens[unTokens] = SToken{pchToken, pchCharacter};
+               }
+               unTokens++;
+            }
+            pchToken = pchCharacter + 1;
+         }
+      }
+      return unTokens;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   bool CDIQtOpenGLUserFunctions::ParseReals(const SToken& s_token,
+                                             Real* pf_values,
+                                             UInt32 un_count) {
+      /* QApplication sets the locale from the environment, the controllers always write a
+         decimal point */
+      static const locale_t tCLocale = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+      const char* pchCursor = s_token.Begin;
+      for(UInt32 unValue = 0; unValue < un_count; unValue++) {
+         if(unValue > 0) {
+            if(pchCursor == s_token.End || *pchCursor != ',') {
+               return false;
+            }
+            pchCursor++;
+         }
+         /* strtod stops at the parenthesis or newline that ends the token */
+         char* pchValueEnd = nullptr;
+         pf_values[unValue] = strtod_l(pchCursor, &pchValueEnd, tCLocale);
+         if(pchValueEnd == pchCursor || pchValueEnd > s_token.End) {
+            return false;
+         }
+         pchCursor = pchValueEnd;
+         while(pchCursor != s_token.End && std::isspace(static_cast<unsigned char>(*pchCursor))) {
+            pchCursor++;
+         }
+      }
+      return pchCursor == s_token.End;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   bool CDIQtOpenGLUserFunctions::ParseVector3(const SToken& s_token, CVector3& c_vector) {
+      Real pfValues[3];
+      if(!ParseReals(s_token, pfValues, 3)) {
+         return false;
+      }
+      c_vector.Set(pfValues[0], pfValues[1], pfValues[2]);
+      return true;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   bool CDIQtOpenGLUserFunctions::ParseColor(const SToken& s_token, CColor& c_color) {
+      static const std::pair<const char*, CColor> psNamedColors[] = {
+         {"black", CColor::BLACK}, {"white", CColor::WHITE}, {"red", CColor::RED},
+         {"green", CColor::GREEN}, {"blue", CColor::BLUE}, {"magenta", CColor::MAGENTA},
+         {"cyan", CColor::CYAN}, {"yellow", CColor::YELLOW}, {"orange", CColor::ORANGE},
+         {"brown", CColor::BROWN}, {"purple", CColor::PURPLE}, {"gray10", CColor::GRAY10},
+         {"gray20", CColor::GRAY20}, {"gray30", CColor::GRAY30}, {"gray40", CColor::GRAY40},
+         {"gray50", CColor::GRAY50}, {"gray60", CColor::GRAY60}, {"gray70", CColor::GRAY70},
+         {"gray80", CColor::GRAY80}, {"gray90", CColor::GRAY90},
+      };
+      if(std::find(s_token.Begin, s_token.End, ',') != s_token.End) {
+         Real pfValues[4] = {0.0, 0.0, 0.0, 255.0};
+         if(!ParseReals(s_token, pfValues, 3) && !ParseReals(s_token, pfValues, 4)) {
+            return false;
+         }
+         for(Real f_value : pfValues) {
+            if(f_value < 0.0 || f_value > 255.0) {
+               return false;
+            }
+         }
+         c_color.Set(static_cast<UInt8>(pfValues[0]),
+                     static_cast<UInt8>(pfValues[1]),
+                     static_cast<UInt8>(pfValues[2]),
+                     static_cast<UInt8>(pfValues[3]));
+         return true;
+      }
+      for(const std::pair<const char*, CColor>& c_named_color : psNamedColors) {
+         if(s_token == c_named_color.first) {
+            c_color = c_named_color.second;
+            return true;
+         }
+      }
+      return false;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::ParseAnnotations(const std::string& str_buffer,
+                                                   std::vector<SAnnotation>& vec_annotations) {
+      vec_annotations.clear();
+      const char* pchBufferEnd = str_buffer.data() + str_buffer.size();
+      for(const char* pchInstruction = str_buffer.data();
+          pchInstruction < pchBufferEnd;
+          pchInstruction = std::find(pchInstruction, pchBufferEnd, '\n') + 1) {
+         const char* pchInstructionEnd = std::find(pchInstruction, pchBufferEnd, '\n');
+         SToken psTokens[4];
+         if(TokenizeInstruction(pchInstruction, pchInstructionEnd, psTokens, 4) != 4) {
+            continue;
+         }
+         SAnnotation sAnnotation;
+         if(psTokens[0] == "arrow" &&
+            ParseColor(psTokens[1], sAnnotation.Color) &&
+            ParseVector3(psTokens[2], sAnnotation.From) &&
+            ParseVector3(psTokens[3], sAnnotation.To)) {
+            sAnnotation.Type = SAnnotation::EType::ARROW;
+            MakeAnnotationTransforms(sAnnotation);
+            vec_annotations.push_back(sAnnotation);
+         }
+         else if(psTokens[0] == "ring" &&
+                 ParseColor(psTokens[1], sAnnotation.Color) &&
+                 ParseVector3(psTokens[2], sAnnotation.From) &&
+                 ParseReals(psTokens[3], &sAnnotation.Radius, 1)) {
+            sAnnotation.Type = SAnnotation::EType::RING;
+            MakeAnnotationTransforms(sAnnotation);
+            vec_annotations.push_back(sAnnotation);
+         }
+      }
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::DrawInWorld() {
+      /* the blocks may have been moved by the physics engines during the last step */
+      UpdateBlockIndex();
+      DrawGroup();
+      m_cBatchRenderer.Flush();
+      /* DrawInWorld is called after the entities, drop the caches of the entities that were not
+         drawn in this frame so that the caches of removed entities do not pile up */
+      for(std::unordered_map<const CDebugEntity*, SAnnotationCache>::iterator itCache =
+             std::begin(m_mapAnnotationCaches);
+          itCache != std::end(m_mapAnnotationCaches);) {
+         if(itCache->second.Frame != m_unFrame) {
+            itCache = m_mapAnnotationCaches.erase(itCache);
+         }
+         else {
+            ++itCache;
+         }
+      }
+      m_unFrame++;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::DrawGroup() {
+      PruneGroup();
+      if(m_vecGroup.size() < 2) {
+         return;
+      }
+      bool bInstancing = m_bInstancing && m_cBatchRenderer.IsSupported();
+      GLfloat pfWorld[16];
+      CDIQtOpenGLBatchRenderer::MakeTransform(pfWorld, CVector3::ZERO, CQuaternion());
+      if(!bInstancing) {
+         glDisable(GL_LIGHTING);
+         glEnable(GL_BLEND);
+         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+         glColor4ub(CColor::YELLOW.GetRed(), CColor::YELLOW.GetGreen(), CColor::YELLOW.GetBlue(), 128u);
+      }
+      CEntity::TMap& mapEntities = CSimulator::GetInstance().GetSpace().GetEntityMapPerId();
+      for(const std::string& str_id : m_vecGroup) {
+         CEntity::TMap::iterator itEntity = mapEntities.find(str_id);
+         if(itEntity == std::end(mapEntities)) {
+            continue;
+         }
+         /* a ring around the bounding box at the bottom of the robot */
+         const SBoundingBox& sBoundingBox =
+            GetRobotEmbodiedEntity(*itEntity->second)->GetBoundingBox();
+         CVector3 cSize(sBoundingBox.MaxCorner - sBoundingBox.MinCorner);
+         SAnnotation sRing;
+         sRing.Type = SAnnotation::EType::RING;
+         sRing.Color = CColor::YELLOW;
+         sRing.From = (sBoundingBox.MinCorner + sBoundingBox.MaxCorner) * 0.5;
+         sRing.From.SetZ(sBoundingBox.MinCorner.GetZ());
+         sRing.Radius = 0.5 * std::max(cSize.GetX(), cSize.GetY());
+         if(bInstancing) {
+            MakeAnnotationTransforms(sRing);
+            AddAnnotation(pfWorld, sRing);
+         }
+         else {
+            DrawRing3(sRing.From, sRing.Radius);
+         }
+      }
+      if(!bInstancing) {
+         glDisable(GL_BLEND);
+         glEnable(GL_LIGHTING);
+      }
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::MakeAnnotationTransforms(SAnnotation& s_annotation) {
+      switch(s_annotation.Type) {
+         case SAnnotation::EType::ARROW: {
+            CVector3 cArrow(s_annotation.To - s_annotation.From);
+            CQuaternion cRotation(CVector3::Z, cArrow / cArrow.Length());
+            /* the head */
+            CDIQtOpenGLBatchRenderer::MakeTransform(s_annotation.Transforms[0],
+                                                    s_annotation.To,
+                                                    cRotation,
+                                                    CVector3(ARROW_HEAD, ARROW_HEAD, ARROW_HEAD));
+            /* the body */
+            CDIQtOpenGLBatchRenderer::MakeTransform(s_annotation.Transforms[1],
+                                                    s_annotation.From,
+                                                    cRotation,
+                                                    CVector3(ARROW_THICKNESS,
+                                                             ARROW_THICKNESS,
+                                                             cArrow.Length() - ARROW_HEAD));
+            break;
+         }
+         case SAnnotation::EType::RING:
+            CDIQtOpenGLBatchRenderer::MakeTransform(s_annotation.Transforms[0],
+                                                    s_annotation.From,
+                                                    CQuaternion(),
+                                                    CVector3(1.0, 1.0, RING_HEIGHT));
+            break;
+      }
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   const GLfloat* CDIQtOpenGLUserFunctions::GetAnchorTransform(SAnnotationCache& s_cache,
+                                                               const SAnchor& s_anchor) {
+      const CQuaternion& cOrientation = s_anchor.Orientation;
+      if(!s_cache.HasAnchorTransform ||
+         s_cache.AnchorPosition != s_anchor.Position ||
+         s_cache.AnchorOrientation.GetW() != cOrientation.GetW() ||
+         s_cache.AnchorOrientation.GetX() != cOrientation.GetX() ||
+         s_cache.AnchorOrientation.GetY() != cOrientation.GetY() ||
+         s_cache.AnchorOrientation.GetZ() != cOrientation.GetZ()) {
+         CDIQtOpenGLBatchRenderer::MakeTransform(s_cache.AnchorTransform,
+                                                 s_anchor.Position,
+                                                 cOrientation);
+         s_cache.AnchorPosition = s_anchor.Position;
+         s_cache.AnchorOrientation = cOrientation;
+         s_cache.HasAnchorTransform = true;
+      }
+      return s_cache.AnchorTransform;
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
+   void CDIQtOpenGLUserFunctions::AddAnnotation(const GLfloat* pf_anchor,
+                                                const SAnnotation& s_annotation) {
+      GLfloat pfTransform[16];
+      switch(s_annotation.Type) {
+         case SAnnotation::EType::ARROW:
+            CDIQtOpenGLBatchRenderer::Multiply(pfTransform, pf_anchor, s_annotation.Transforms[0]);
+            m_cBatchRenderer.Add(CDIQtOpenGLBatchRenderer::EShape::CONE,
+                                 pfTransform,
+                                 s_annotation.Color);
+            CDIQtOpenGLBatchRenderer::Multiply(pfTransform, pf_anchor, s_annotation.Transforms[1]);
+            m_cBatchRenderer.Add(CDIQtOpenGLBatchRenderer::EShape::CYLINDER,
+                                 pfTransform,
+                                 s_annotation.Color);
+            break;
+         case SAnnotation::EType::RING:
+            CDIQtOpenGLBatchRenderer::Multiply(pfTransform, pf_anchor, s_annotation.Transforms[0]);
+            /* the unit ring has a radius of 0.5, the outer wall is thicker like in DrawRing3 */
+            m_cBatchRenderer.Add(CDIQtOpenGLBatchRenderer::EShape::RING,
+                                 pfTransform,
+                                 s_annotation.Color,
+                                 2.0 * s_annotation.Radius,
+                                 2.0 * s_annotation.Radius + RING_THICKNESS);
+            break;
+      }
+   }
+
+   /********************************************************************************/
+   /********************************************************************************/
+
    void CDIQtOpenGLUserFunctions::DrawRing3(const CVector3& c_center, Real f_radius) {
       const CCachedShapes& cCachedShapes = CCachedShapes::GetCachedShapes();
-      const Real fRingHeight = 0.015625;
-      const Real fRingThickness = 0.015625;
+      const Real fRingHeight = RING_HEIGHT;
+      const Real fRingThickness = RING_THICKNESS;
       const Real fHalfRingThickness = fRingThickness * 0.5;
       const Real fDiameter = 2.0 * f_radius;
       /* draw inner ring surface */
@@ -246,30 +858,16 @@ namespace argos {
    /********************************************************************************/
    /********************************************************************************/
 
-   void CDIQtOpenGLUserFunctions::DrawArrow3(const CVector3& c_from, const CVector3& c_to) {
+   void CDIQtOpenGLUserFunctions::DrawArrow3(const SAnnotation& s_arrow) {
       const CCachedShapes& cCachedShapes = CCachedShapes::GetCachedShapes();
-      const Real fArrowThickness = 0.015625f;
-      const Real fArrowHead =      0.031250f;
-      CVector3 cArrow(c_to - c_from);
-      CQuaternion cRotation(CVector3::Z, cArrow / cArrow.Length());
-      CRadians cZAngle, cYAngle, cXAngle;
-      cRotation.ToEulerAngles(cZAngle, cYAngle, cXAngle);
-      /* draw arrow body */
+      /* draw arrow head */
       glPushMatrix();
-      glTranslatef(c_to.GetX(), c_to.GetY(), c_to.GetZ());
-      glRotatef(ToDegrees(cXAngle).GetValue(), 1.0f, 0.0f, 0.0f);
-      glRotatef(ToDegrees(cYAngle).GetValue(), 0.0f, 1.0f, 0.0f);
-      glRotatef(ToDegrees(cZAngle).GetValue(), 0.0f, 0.0f, 1.0f);
-      glScalef(fArrowHead, fArrowHead, fArrowHead);
+      glMultMatrixf(s_arrow.Transforms[0]);
       glCallList(cCachedShapes.GetCone());
       glPopMatrix();
-      /* draw arrow head */
+      /* draw arrow body */
       glPushMatrix();
-      glTranslatef(c_from.GetX(), c_from.GetY(), c_from.GetZ());
-      glRotatef(ToDegrees(cXAngle).GetValue(), 1.0f, 0.0f, 0.0f);
-      glRotatef(ToDegrees(cYAngle).GetValue(), 0.0f, 1.0f, 0.0f);
-      glRotatef(ToDegrees(cZAngle).GetValue(), 0.0f, 0.0f, 1.0f);
-      glScalef(fArrowThickness, fArrowThickness, cArrow.Length() - fArrowHead);
+      glMultMatrixf(s_arrow.Transforms[1]);
       glCallList(cCachedShapes.GetCylinder());
       glPopMatrix();
    }
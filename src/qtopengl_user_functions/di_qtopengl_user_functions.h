@@ -13,6 +13,14 @@ namespace argos {
 #include <argos3/plugins/robots/pi-puck/simulator/pipuck_entity.h>
 #include <argos3/plugins/robots/drone/simulator/drone_entity.h>
 
+#include <loop_functions/di_srocs_spatial_hash.h>
+
+#include "di_qtopengl_batch_renderer.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 namespace argos {
    class CDIQtOpenGLUserFunctionsMouseWheelEventHandler : public QObject {
       Q_OBJECT
@@ -45,6 +53,14 @@ namespace argos {
                                const CVector3& c_old_pos,
                                const CVector3& c_new_pos);
 
+      /* selecting a robot with the control key held adds it to the group or removes it from the
+         group, selecting an entity that is not in the group without the control key clears the
+         group, selecting a robot of the group without the control key keeps the group */
+      virtual void EntitySelected(CEntity& c_entity);
+
+      /* draws the annotations that have been batched during the frame */
+      virtual void DrawInWorld();
+
       inline void Annotate(CBuilderBotEntity& c_entity) {
          Annotate(c_entity.GetDebugEntity(),
                   c_entity.GetEmbodiedEntity().GetOriginAnchor());
@@ -63,13 +79,154 @@ namespace argos {
       void Annotate(CDebugEntity& c_debug_entity,
                     const SAnchor& s_anchor);
 
+      /* returns the index of a block whose origin is within f_tolerance of c_position or
+         CDISRoCSSpatialHash::NONE, the index is valid until the simulation is stepped */
+      UInt32 FindBlock(const CVector3& c_position, Real f_tolerance);
+
+      CBlockEntity& GetBlock(UInt32 un_block) {
+         return *m_vecBlocks[un_block];
+      }
+
+      /* updates the index after a block has been moved */
+      void BlockMoved(UInt32 un_block);
+
+      /* returns the embodied entity of a builderbot, a pi-puck or a drone, otherwise nullptr */
+      static CEmbodiedEntity* GetRobotEmbodiedEntity(CEntity& c_entity);
+
+      /* whether the entity is a robot of a group of at least two robots */
+      bool IsGroupMember(const CEntity& c_entity) const;
+
+      /* moves the robots of the group and the blocks that the builderbots carry as a rigid set,
+         they are rotated by c_rotation around c_pivot and then translated by c_translation. If
+         an entity cannot be moved, all entities are moved back and false is returned. The robot
+         pc_moved, if any, has already been translated by c_translation */
+      bool MoveGroup(const CVector3& c_pivot,
+                     const CQuaternion& c_rotation,
+                     const CVector3& c_translation,
+                     CEmbodiedEntity* pc_moved = nullptr);
+
+   private:
+
+      /* synchronizes the block index with the blocks in the space */
+      void UpdateBlockIndex();
+
+      /* drops the identifiers of the group whose entities are no longer robots */
+      void PruneGroup();
+
+      /* draws a ring around each robot of the group */
+      void DrawGroup();
+
    private:
 
       CDIQtOpenGLUserFunctionsMouseWheelEventHandler* m_pcMouseWheelEventHandler;
 
+      /* draw the annotations with instancing if the OpenGL context supports it */
+      bool m_bInstancing = true;
+      CDIQtOpenGLBatchRenderer m_cBatchRenderer;
+
+      /* the blocks in cells of the size of a block, updated once per frame and when the blocks
+         are moved by the user functions */
+      CDISRoCSSpatialHash m_cBlockIndex;
+      std::vector<CBlockEntity*> m_vecBlocks;
+      /* the simulation clock when the index was last synchronized with the space */
+      UInt32 m_unBlockIndexClock = 0;
+
+      /* the identifiers of the robots of the group, robots that have been removed from the space
+         are skipped */
+      std::vector<std::string> m_vecGroup;
+
+      /* an entity of a group move, kept between the moves to reuse the memory */
+      struct SGroupMember {
+         CEmbodiedEntity* EmbodiedEntity;
+         /* the index of a block or CDISRoCSSpatialHash::NONE for a robot */
+         UInt32 Block;
+         /* the pose at the start of the move, which differs from the initial pose for a robot
+            that has already been moved */
+         CVector3 StartPosition;
+         CQuaternion StartOrientation;
+         CVector3 InitPosition;
+         CQuaternion InitOrientation;
+         CVector3 TargetPosition;
+         CQuaternion TargetOrientation;
+      };
+      std::vector<SGroupMember> m_vecGroupMembers;
+
+   private:
+
+      /* a primitive of the "draw" buffer of a debug entity */
+      struct SAnnotation {
+         enum class EType : UInt8 {
+            ARROW,
+            RING,
+         } Type;
+         CColor Color;
+         /* the tail of an arrow or the center of a ring */
+         CVector3 From;
+         CVector3 To;
+         Real Radius;
+         /* the transforms of the shapes relative to the anchor, computed when parsing: the
+            head and the body of an arrow or the ring */
+         GLfloat Transforms[2][16];
+      };
+
+      /* the primitives of a debug entity, parsed again only when its "draw" buffer changes */
+      struct SAnnotationCache {
+         size_t Hash = 0;
+         size_t Length = 0;
+         std::vector<SAnnotation> Annotations;
+         /* the transform of the anchor, computed again only when the anchor has moved */
+         bool HasAnchorTransform = false;
+         CVector3 AnchorPosition;
+         CQuaternion AnchorOrientation;
+         GLfloat AnchorTransform[16];
+         /* the last frame in which the entity was drawn */
+         UInt32 Frame = 0;
+      };
+
+      std::unordered_map<const CDebugEntity*, SAnnotationCache> m_mapAnnotationCaches;
+      UInt32 m_unFrame = 0;
+
    private:
 
-      void DrawArrow3(const CVector3& c_from, const CVector3& c_to);
+      /* a range of characters of a "draw" buffer */
+      struct SToken {
+         const char* Begin;
+         const char* End;
+         /* compares the characters in lower case with a lower case string */
+         bool operator==(const char* pch_string) const;
+      };
+
+      /* splits an instruction at the parentheses into non-empty tokens, returns the number of
+         tokens, of which at most un_max_tokens are stored */
+      static UInt32 TokenizeInstruction(const char* pch_begin,
+                                        const char* pch_end,
+                                        SToken* ps_tokens,
+                                        UInt32 un_max_tokens);
+
+      /* parses un_count comma-separated numbers that fill the whole token */
+      static bool ParseReals(const SToken& s_token, Real* pf_values, UInt32 un_count);
+
+      static bool ParseVector3(const SToken& s_token, CVector3& c_vector);
+
+      /* parses "r,g,b", "r,g,b,a" or one of the names accepted by CColor */
+      static bool ParseColor(const SToken& s_token, CColor& c_color);
+
+      /* parses the instructions of a "draw" buffer (one per line), invalid instructions are
+         skipped, the primitives are written into vec_annotations reusing its memory */
+      static void ParseAnnotations(const std::string& str_buffer,
+                                   std::vector<SAnnotation>& vec_annotations);
+
+      /* computes the transforms of the shapes of a parsed annotation */
+      static void MakeAnnotationTransforms(SAnnotation& s_annotation);
+
+      /* returns the transform of the anchor, from the cache if the anchor has not moved */
+      static const GLfloat* GetAnchorTransform(SAnnotationCache& s_cache, const SAnchor& s_anchor);
+
+      /* adds the shapes of an annotation to the batch, pf_anchor is the transform of the anchor
+         that the annotation is relative to */
+      void AddAnnotation(const GLfloat* pf_anchor, const SAnnotation& s_annotation);
+
+      void DrawArrow3(const SAnnotation& s_arrow);
 
       void DrawRing3(const CVector3& c_center, Real f_radius);
 